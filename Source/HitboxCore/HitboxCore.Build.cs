@@ -0,0 +1,12 @@
+using UnrealBuildTool;
+
+public class HitboxCore : ModuleRules
+{
+	public HitboxCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		//Only Core, so that the collision math can be built and run without the engine.
+		PublicDependencyModuleNames.AddRange(new string[] { "Core" });
+	}
+}
@@ -0,0 +1,339 @@
+﻿#include "HitboxCollision.h"
+
+FHitboxShape2D FHitboxShape2D::MakeCapsule(const float Radius, const float InHalfHeight, const float InAngle)
+{
+	FHitboxShape2D Shape;
+	Shape.HalfHeight = FMath::Max(FMath::Abs(InHalfHeight) - FMath::Abs(Radius), 0.0f);
+	Shape.Rounding = FMath::Abs(Radius);
+	Shape.Angle = InAngle;
+	return Shape;
+}
+
+FHitboxShape2D FHitboxShape2D::MakeBox(const float InHalfWidth, const float InHalfHeight, const float InAngle)
+{
+	FHitboxShape2D Shape;
+	Shape.HalfWidth = FMath::Abs(InHalfWidth);
+	Shape.HalfHeight = FMath::Abs(InHalfHeight);
+	Shape.Angle = InAngle;
+	return Shape;
+}
+
+namespace
+{
+	//The four corners of a shape's box, in order around the box, one per lane.
+	struct FBoxCorners
+	{
+		VectorRegister4Float X;
+		VectorRegister4Float Z;
+		float CornerX[4];
+		float CornerZ[4];
+
+		FBoxCorners(const float CenterX, const float CenterZ, const FHitboxShape2D& Shape)
+		{
+			float Sin, Cos;
+			FMath::SinCos(&Sin, &Cos, Shape.Angle);
+			const float AlongX = Shape.HalfWidth * Cos;
+			const float AlongZ = Shape.HalfWidth * Sin;
+			const float UpX = -Shape.HalfHeight * Sin;
+			const float UpZ = Shape.HalfHeight * Cos;
+			CornerX[0] = CenterX + AlongX + UpX;
+			CornerZ[0] = CenterZ + AlongZ + UpZ;
+			CornerX[1] = CenterX - AlongX + UpX;
+			CornerZ[1] = CenterZ - AlongZ + UpZ;
+			CornerX[2] = CenterX - AlongX - UpX;
+			CornerZ[2] = CenterZ - AlongZ - UpZ;
+			CornerX[3] = CenterX + AlongX - UpX;
+			CornerZ[3] = CenterZ + AlongZ - UpZ;
+			X = VectorLoad(CornerX);
+			Z = VectorLoad(CornerZ);
+		}
+	};
+
+	//Squared distance from each of four points to one segment, one point per lane.
+	VectorRegister4Float PointsToSegmentDistanceSquared(const VectorRegister4Float& PointsX, const VectorRegister4Float& PointsZ,
+		const float StartX, const float StartZ, const float EndX, const float EndZ)
+	{
+		const float EdgeX = EndX - StartX;
+		const float EdgeZ = EndZ - StartZ;
+		//Edges of capsules and circles can have no length. The max keeps the division finite, and every point then clamps to the start.
+		const float InvLengthSquared = 1.0f / FMath::Max(EdgeX * EdgeX + EdgeZ * EdgeZ, UE_SMALL_NUMBER);
+		const VectorRegister4Float EdgeXRegister = VectorSetFloat1(EdgeX);
+		const VectorRegister4Float EdgeZRegister = VectorSetFloat1(EdgeZ);
+		const VectorRegister4Float ToPointX = VectorSubtract(PointsX, VectorSetFloat1(StartX));
+		const VectorRegister4Float ToPointZ = VectorSubtract(PointsZ, VectorSetFloat1(StartZ));
+		//How far along the edge each point's closest point is, clamped to the ends of the edge.
+		VectorRegister4Float Along = VectorMultiply(VectorMultiplyAdd(ToPointX, EdgeXRegister, VectorMultiply(ToPointZ, EdgeZRegister)), VectorSetFloat1(InvLengthSquared));
+		Along = VectorMin(VectorMax(Along, VectorZeroFloat()), VectorOneFloat());
+		const VectorRegister4Float DeltaX = VectorNegateMultiplyAdd(Along, EdgeXRegister, ToPointX);
+		const VectorRegister4Float DeltaZ = VectorNegateMultiplyAdd(Along, EdgeZRegister, ToPointZ);
+		return VectorMultiplyAdd(DeltaX, DeltaX, VectorMultiply(DeltaZ, DeltaZ));
+	}
+
+	//Absolute projection of a box's half extents onto four axes at once.
+	VectorRegister4Float ProjectBox(const FHitboxShape2D& Shape, const VectorRegister4Float& AxesX, const VectorRegister4Float& AxesZ)
+	{
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, Shape.Angle);
+		const VectorRegister4Float AlongDot = VectorAbs(VectorMultiplyAdd(VectorSetFloat1(Cos), AxesX, VectorMultiply(VectorSetFloat1(Sin), AxesZ)));
+		const VectorRegister4Float UpDot = VectorAbs(VectorMultiplyAdd(VectorSetFloat1(-Sin), AxesX, VectorMultiply(VectorSetFloat1(Cos), AxesZ)));
+		return VectorMultiplyAdd(VectorSetFloat1(Shape.HalfWidth), AlongDot, VectorMultiply(VectorSetFloat1(Shape.HalfHeight), UpDot));
+	}
+}
+
+
+void HitboxCollision::ProcessCollision(const FHitboxCollisionParams& This, const FHitboxCollisionParams& Other, FHitboxCollisionResult& Result)
+{
+	//Being above the other hitbox's threshold means we landed on it, which decides who bounces and who gets damaged.
+	const bool bAbove = This.GetMinZ() > Other.GetThresholdHeight();
+	const EHitboxInteraction Interaction = HitboxInteractions::Lookup(This.Capabilities, Other.Capabilities, bAbove);
+	if (EnumHasAnyFlags(Interaction, EHitboxInteraction::DamageOther))
+	{
+		Result.DamageToOther = This.CollisionDamage;
+	}
+	if (EnumHasAnyFlags(Interaction, EHitboxInteraction::BounceThis))
+	{
+		Result.ImpulseToThis = Other.BounceImpulse;
+	}
+	if (EnumHasAnyFlags(Interaction, EHitboxInteraction::DamageThis))
+	{
+		Result.DamageToThis = Other.CollisionDamage;
+	}
+	if (EnumHasAnyFlags(Interaction, EHitboxInteraction::BounceOther))
+	{
+		Result.ImpulseToOther = This.BounceImpulse;
+	}
+}
+
+bool HitboxCollision::AreShapesTouching(const FVector& FirstLocation, const FHitboxShape2D& FirstShape, const FVector& SecondLocation, const FHitboxShape2D& SecondShape,
+	const float Slack)
+{
+	const float MaxDistance = FirstShape.Rounding + SecondShape.Rounding + Slack;
+	if (FirstShape.IsCircle() && SecondShape.IsCircle())
+	{
+		return AreTouchingInPlane(FirstLocation, FirstShape.Rounding + Slack, SecondLocation, SecondShape.Rounding);
+	}
+	//Work relative to the first shape, so that the rest can be done in single precision however far the hitboxes are from the origin.
+	const float OffsetX = static_cast<float>(SecondLocation.X - FirstLocation.X);
+	const float OffsetZ = static_cast<float>(SecondLocation.Z - FirstLocation.Z);
+	//Separating axis test of the two boxes without their rounding. The candidate axes are each box's X and Z axes, one per lane.
+	float FirstSin, FirstCos, SecondSin, SecondCos;
+	FMath::SinCos(&FirstSin, &FirstCos, FirstShape.Angle);
+	FMath::SinCos(&SecondSin, &SecondCos, SecondShape.Angle);
+	const VectorRegister4Float AxesX = MakeVectorRegisterFloat(FirstCos, -FirstSin, SecondCos, -SecondSin);
+	const VectorRegister4Float AxesZ = MakeVectorRegisterFloat(FirstSin, FirstCos, SecondSin, SecondCos);
+	const VectorRegister4Float CenterDistance = VectorAbs(VectorMultiplyAdd(VectorSetFloat1(OffsetX), AxesX, VectorMultiply(VectorSetFloat1(OffsetZ), AxesZ)));
+	const VectorRegister4Float Extents = VectorAdd(ProjectBox(FirstShape, AxesX, AxesZ), ProjectBox(SecondShape, AxesX, AxesZ));
+	//The boxes themselves overlap, so the rounded shapes must too.
+	if (!VectorAnyGreaterThan(CenterDistance, Extents))
+	{
+		return true;
+	}
+	//Otherwise the closest points between two convex shapes are a corner of one and an edge of the other.
+	//Each edge is tested against all four of the other box's corners at once.
+	const FBoxCorners FirstCorners(0.0f, 0.0f, FirstShape);
+	const FBoxCorners SecondCorners(OffsetX, OffsetZ, SecondShape);
+	VectorRegister4Float MinDistanceSquared = VectorSetFloat1(UE_BIG_NUMBER);
+	for (int32 Edge = 0; Edge < 4; Edge++)
+	{
+		const int32 Next = (Edge + 1) & 3;
+		MinDistanceSquared = VectorMin(MinDistanceSquared, PointsToSegmentDistanceSquared(FirstCorners.X, FirstCorners.Z,
+			SecondCorners.CornerX[Edge], SecondCorners.CornerZ[Edge], SecondCorners.CornerX[Next], SecondCorners.CornerZ[Next]));
+		MinDistanceSquared = VectorMin(MinDistanceSquared, PointsToSegmentDistanceSquared(SecondCorners.X, SecondCorners.Z,
+			FirstCorners.CornerX[Edge], FirstCorners.CornerZ[Edge], FirstCorners.CornerX[Next], FirstCorners.CornerZ[Next]));
+	}
+	float Lanes[4];
+	VectorStore(MinDistanceSquared, Lanes);
+	return FMath::Min(FMath::Min(Lanes[0], Lanes[1]), FMath::Min(Lanes[2], Lanes[3])) <= FMath::Square(MaxDistance);
+}
+
+void HitboxCollision::ReplayCollision(const FHitboxCollisionParams& This, const FHitboxCollisionParams& Other, const float ToleranceMultiplier,
+	const float PositionError, FHitboxCollisionOutcome& Outcome)
+{
+	//Circles keep the original check. Other shapes get the same amount of slack, measured from their actual outlines instead of their bounding circles.
+	const float CombinedRadius = This.Radius + Other.Radius;
+	const float Slack = CombinedRadius * (ToleranceMultiplier - 1.0f) + PositionError;
+	const bool bTouching = This.Shape.IsCircle() && Other.Shape.IsCircle()
+		? FVector::DistSquared(This.Location, Other.Location) <= FMath::Square(static_cast<double>(CombinedRadius + Slack))
+		: AreShapesTouching(This.Location, This.Shape, Other.Location, Other.Shape, Slack);
+	if (!bTouching)
+	{
+		Outcome = FHitboxCollisionOutcome();
+		return;
+	}
+	//Re-run the collision, and only keep the outcomes that were reported that also happen here.
+	FHitboxCollisionResult Result;
+	ProcessCollision(This, Other, Result);
+	Outcome.bBouncedThis &= !Result.ImpulseToThis.IsZero();
+	Outcome.bBouncedOther &= !Result.ImpulseToOther.IsZero();
+	Outcome.bDamagedThis &= Result.DamageToThis != 0.0f;
+	Outcome.bDamagedOther &= Result.DamageToOther != 0.0f;
+}
+
+bool HitboxCollision::SweepCircles(const FVector& FirstStart, const FVector& FirstEnd, const FVector& SecondStart, const FVector& SecondEnd,
+	const float CombinedRadius, float& OutTimeOfImpact)
+{
+	//Work in the second hitbox's frame of reference, where the first moves from StartOffset to EndOffset.
+	const FVector2D StartOffset(FirstStart.X - SecondStart.X, FirstStart.Z - SecondStart.Z);
+	const FVector2D EndOffset(FirstEnd.X - SecondEnd.X, FirstEnd.Z - SecondEnd.Z);
+	const FVector2D Motion = EndOffset - StartOffset;
+	const double RadiusSquared = FMath::Square(static_cast<double>(CombinedRadius));
+	//Already touching at the start of the frame.
+	const double C = StartOffset.SizeSquared() - RadiusSquared;
+	if (C <= 0.0)
+	{
+		OutTimeOfImpact = 0.0f;
+		return true;
+	}
+	//Solve |StartOffset + Motion * t| = Radius for the first t in [0, 1].
+	const double A = Motion.SizeSquared();
+	const double B = 2.0 * FVector2D::DotProduct(StartOffset, Motion);
+	//Moving apart, or not moving relative to each other at all.
+	if (A <= UE_DOUBLE_SMALL_NUMBER || B >= 0.0)
+	{
+		return false;
+	}
+	const double Discriminant = B * B - 4.0 * A * C;
+	if (Discriminant < 0.0)
+	{
+		return false;
+	}
+	const double Time = (-B - FMath::Sqrt(Discriminant)) / (2.0 * A);
+	if (Time > 1.0)
+	{
+		return false;
+	}
+	OutTimeOfImpact = static_cast<float>(FMath::Max(Time, 0.0));
+	return true;
+}
+
+float HitboxCollision::FindTimeOfImpact(const FVector& FirstStart, const FVector& FirstEnd, const FHitboxShape2D& FirstShape,
+	const FVector& SecondStart, const FVector& SecondEnd, const FHitboxShape2D& SecondShape, const float StartTime)
+{
+	static constexpr int32 NumSteps = 10;
+	auto AreTouchingAt = [&](const float Time)
+	{
+		return AreShapesTouching(FMath::Lerp(FirstStart, FirstEnd, static_cast<double>(Time)), FirstShape,
+			FMath::Lerp(SecondStart, SecondEnd, static_cast<double>(Time)), SecondShape);
+	};
+	if (AreTouchingAt(StartTime))
+	{
+		return StartTime;
+	}
+	//Low is always a time they weren't touching, and High a time they were.
+	float Low = StartTime;
+	float High = 1.0f;
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		const float Mid = (Low + High) * 0.5f;
+		if (AreTouchingAt(Mid))
+		{
+			High = Mid;
+		}
+		else
+		{
+			Low = Mid;
+		}
+	}
+	return High;
+}
+
+FHitboxRewindFrame HitboxCollision::FindRewindFrame(TConstArrayView<double> RingFrameTimes, const int64 OldestFrame, const int32 NumFrames,
+	const double Timestamp, const double CurrentTime)
+{
+	FHitboxRewindFrame RewindFrame;
+	if (NumFrames == 0 || RingFrameTimes.Num() == 0)
+	{
+		return RewindFrame;
+	}
+	const int32 RingSize = RingFrameTimes.Num();
+	auto GetFrameTime = [&RingFrameTimes, RingSize](const int64 Frame) { return RingFrameTimes[static_cast<int32>(Frame % RingSize)]; };
+	//Frames are recorded in time order, so find the oldest frame at or after the timestamp.
+	int32 Low = 0;
+	int32 High = NumFrames;
+	while (Low < High)
+	{
+		const int32 Mid = Low + (High - Low) / 2;
+		if (GetFrameTime(OldestFrame + Mid) < Timestamp)
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+	//If every frame is at or after the timestamp, the oldest one is the best we have.
+	if (Low == 0)
+	{
+		RewindFrame.AfterFrame = OldestFrame;
+		return RewindFrame;
+	}
+	RewindFrame.BeforeFrame = OldestFrame + Low - 1;
+	const double TimeBefore = GetFrameTime(RewindFrame.BeforeFrame);
+	//If every frame is before the timestamp, we lerp between the newest frame and the current time.
+	double TimeAfter = CurrentTime;
+	if (Low < NumFrames)
+	{
+		RewindFrame.AfterFrame = OldestFrame + Low;
+		TimeAfter = GetFrameTime(RewindFrame.AfterFrame);
+	}
+	RewindFrame.Alpha = TimeAfter > TimeBefore ? static_cast<float>(FMath::Clamp((Timestamp - TimeBefore) / (TimeAfter - TimeBefore), 0.0, 1.0)) : 1.0f;
+	return RewindFrame;
+}
+
+void FHitboxLerpBatch::SetNum(const int32 NewNum)
+{
+	NumQueries = NewNum;
+	const int32 PaddedNum = Align(NewNum, QueriesPerRegister);
+	for (TArray<double>* Lane : { &BeforeX, &BeforeY, &BeforeZ, &AfterX, &AfterY, &AfterZ, &Alphas })
+	{
+		Lane->SetNumZeroed(PaddedNum, false);
+	}
+}
+
+void FHitboxLerpBatch::Set(const int32 Query, const FVector& Before, const FVector& After, const float Alpha)
+{
+	BeforeX[Query] = Before.X;
+	BeforeY[Query] = Before.Y;
+	BeforeZ[Query] = Before.Z;
+	AfterX[Query] = After.X;
+	AfterY[Query] = After.Y;
+	AfterZ[Query] = After.Z;
+	Alphas[Query] = Alpha;
+}
+
+void HitboxCollision::LerpPositions(const FHitboxLerpBatch& Batch, TArrayView<FVector> OutPositions)
+{
+	check(OutPositions.Num() >= Batch.Num());
+	for (int32 Query = 0; Query < Batch.Num(); Query += FHitboxLerpBatch::QueriesPerRegister)
+	{
+		const VectorRegister4Double Alpha = VectorLoad(&Batch.Alphas[Query]);
+		const VectorRegister4Double BeforeX = VectorLoad(&Batch.BeforeX[Query]);
+		const VectorRegister4Double BeforeY = VectorLoad(&Batch.BeforeY[Query]);
+		const VectorRegister4Double BeforeZ = VectorLoad(&Batch.BeforeZ[Query]);
+		double X[FHitboxLerpBatch::QueriesPerRegister];
+		double Y[FHitboxLerpBatch::QueriesPerRegister];
+		double Z[FHitboxLerpBatch::QueriesPerRegister];
+		VectorStore(VectorMultiplyAdd(VectorSubtract(VectorLoad(&Batch.AfterX[Query]), BeforeX), Alpha, BeforeX), X);
+		VectorStore(VectorMultiplyAdd(VectorSubtract(VectorLoad(&Batch.AfterY[Query]), BeforeY), Alpha, BeforeY), Y);
+		VectorStore(VectorMultiplyAdd(VectorSubtract(VectorLoad(&Batch.AfterZ[Query]), BeforeZ), Alpha, BeforeZ), Z);
+		const int32 NumLanes = FMath::Min(Batch.Num() - Query, FHitboxLerpBatch::QueriesPerRegister);
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			OutPositions[Query + Lane] = FVector(X[Lane], Y[Lane], Z[Lane]);
+		}
+	}
+}
+
+void HitboxCollision::LerpPositionsScalar(const FHitboxLerpBatch& Batch, TArrayView<FVector> OutPositions)
+{
+	check(OutPositions.Num() >= Batch.Num());
+	for (int32 Query = 0; Query < Batch.Num(); Query++)
+	{
+		const double Alpha = Batch.Alphas[Query];
+		OutPositions[Query] = FVector(
+			FMath::Lerp(Batch.BeforeX[Query], Batch.AfterX[Query], Alpha),
+			FMath::Lerp(Batch.BeforeY[Query], Batch.AfterY[Query], Alpha),
+			FMath::Lerp(Batch.BeforeZ[Query], Batch.AfterZ[Query], Alpha));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,259 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+
+//Hitbox collision and lag compensation math, kept free of UObjects so that it only needs Core.
+//The game module gathers hitbox state into these structs and calls in here to resolve collisions and rewind positions.
+
+//What a hitbox is able to do to, or have done to it by, other hitboxes.
+enum class EHitboxCapabilities : uint8
+{
+	None = 0,
+	Bouncy = 1 << 0,
+	CanBeBounced = 1 << 1,
+	DealsDamage = 1 << 2,
+	CanBeDamaged = 1 << 3
+};
+ENUM_CLASS_FLAGS(EHitboxCapabilities);
+
+//Which effects a collision has, named from the point of view of the hitbox processing it.
+enum class EHitboxInteraction : uint8
+{
+	None = 0,
+	BounceThis = 1 << 0,
+	BounceOther = 1 << 1,
+	DamageThis = 1 << 2,
+	DamageOther = 1 << 3
+};
+ENUM_CLASS_FLAGS(EHitboxInteraction);
+
+//Compile-time table of collision outcomes, indexed by the capabilities of both hitboxes and whether the processing hitbox was above the other's threshold.
+namespace HitboxInteractions
+{
+	static constexpr int32 NumCapabilityMasks = 1 << 4;
+
+	//The collision rules. A hitbox above the other's threshold lands on it: it damages the other and gets bounced by it.
+	//A hitbox below the threshold instead takes damage from the other and may bounce it.
+	constexpr uint8 Resolve(const uint8 This, const uint8 Other, const bool bAbove)
+	{
+		constexpr uint8 Bouncy = static_cast<uint8>(EHitboxCapabilities::Bouncy);
+		constexpr uint8 CanBeBounced = static_cast<uint8>(EHitboxCapabilities::CanBeBounced);
+		constexpr uint8 DealsDamage = static_cast<uint8>(EHitboxCapabilities::DealsDamage);
+		constexpr uint8 CanBeDamaged = static_cast<uint8>(EHitboxCapabilities::CanBeDamaged);
+		uint8 Interaction = 0;
+		if (bAbove)
+		{
+			if ((This & DealsDamage) && (Other & CanBeDamaged))
+			{
+				Interaction |= static_cast<uint8>(EHitboxInteraction::DamageOther);
+			}
+			if ((This & CanBeBounced) && (Other & Bouncy))
+			{
+				Interaction |= static_cast<uint8>(EHitboxInteraction::BounceThis);
+			}
+		}
+		else
+		{
+			if ((This & CanBeDamaged) && (Other & DealsDamage))
+			{
+				Interaction |= static_cast<uint8>(EHitboxInteraction::DamageThis);
+			}
+			if ((This & Bouncy) && (Other & CanBeBounced))
+			{
+				Interaction |= static_cast<uint8>(EHitboxInteraction::BounceOther);
+			}
+		}
+		return Interaction;
+	}
+
+	struct FTable
+	{
+		uint8 Entries[NumCapabilityMasks][NumCapabilityMasks][2] = {};
+	};
+
+	constexpr FTable BuildTable()
+	{
+		FTable Table;
+		for (uint8 This = 0; This < NumCapabilityMasks; This++)
+		{
+			for (uint8 Other = 0; Other < NumCapabilityMasks; Other++)
+			{
+				Table.Entries[This][Other][0] = Resolve(This, Other, false);
+				Table.Entries[This][Other][1] = Resolve(This, Other, true);
+			}
+		}
+		return Table;
+	}
+
+	inline constexpr FTable Table = BuildTable();
+
+	inline EHitboxInteraction Lookup(const EHitboxCapabilities This, const EHitboxCapabilities Other, const bool bAbove)
+	{
+		return static_cast<EHitboxInteraction>(Table.Entries[static_cast<uint8>(This)][static_cast<uint8>(Other)][bAbove ? 1 : 0]);
+	}
+}
+
+//A hitbox's shape in the X/Z plane, as a box with its edges rounded off by a radius.
+//Every hitbox shape is one of these, so one narrowphase handles every pair of shapes:
+//circles are all rounding, capsules are a box with no width, and boxes have no rounding.
+struct FHitboxShape2D
+{
+	//Half extents of the box along its own X and Z axes, not counting the rounding.
+	float HalfWidth = 0.0f;
+	float HalfHeight = 0.0f;
+	float Rounding = 0.0f;
+	//Rotation of the box's X axis towards world Z, in radians.
+	float Angle = 0.0f;
+
+	static FHitboxShape2D MakeCircle(const float Radius) { FHitboxShape2D Shape; Shape.Rounding = FMath::Abs(Radius); return Shape; }
+	//Half height includes the caps, like a capsule component's.
+	//Sizes are taken by magnitude, since a mirrored component's negative scale flips the shape onto itself.
+	HITBOXCORE_API static FHitboxShape2D MakeCapsule(const float Radius, const float InHalfHeight, const float InAngle);
+	HITBOXCORE_API static FHitboxShape2D MakeBox(const float InHalfWidth, const float InHalfHeight, const float InAngle);
+
+	bool IsCircle() const { return HalfWidth == 0.0f && HalfHeight == 0.0f; }
+	float GetBoundingRadius() const { return FMath::Sqrt(FMath::Square(HalfWidth) + FMath::Square(HalfHeight)) + Rounding; }
+	//Half of the shape's extent along world Z, which is what the landing threshold is measured against.
+	float GetVerticalHalfExtent() const { return FMath::Abs(HalfWidth * FMath::Sin(Angle)) + FMath::Abs(HalfHeight * FMath::Cos(Angle)) + Rounding; }
+};
+
+//Everything needed to resolve one side of a hitbox collision, independent of the component.
+//This lets the server replay collisions using rewound positions.
+struct FHitboxCollisionParams
+{
+	FVector Location = FVector::ZeroVector;
+	//Radius of the circle around the hitbox's shape. This is only used for the loose distance checks.
+	float Radius = 0.0f;
+	FHitboxShape2D Shape;
+	//Fraction of the hitbox's height, from the bottom, that the other hitbox's bottom must be above to count as landing on top.
+	float CollisionThreshold = 0.75f;
+	EHitboxCapabilities Capabilities = EHitboxCapabilities::None;
+	FVector BounceImpulse = FVector::ZeroVector;
+	float CollisionDamage = 0.0f;
+
+	float GetMinZ() const { return Location.Z - Shape.GetVerticalHalfExtent(); }
+	float GetThresholdHeight() const { return FMath::Lerp(Location.Z - Shape.GetVerticalHalfExtent(), Location.Z + Shape.GetVerticalHalfExtent(), CollisionThreshold); }
+};
+
+struct FHitboxCollisionResult
+{
+	FVector ImpulseToThis = FVector::ZeroVector;
+	FVector ImpulseToOther = FVector::ZeroVector;
+	float DamageToThis = 0.0f;
+	float DamageToOther = 0.0f;
+};
+
+//The bounce and damage outcomes of a collision, as reported by a client in its move.
+//Named from the point of view of the hitbox that processed the collision.
+struct FHitboxCollisionOutcome
+{
+	bool bBouncedThis = false;
+	bool bBouncedOther = false;
+	bool bDamagedThis = false;
+	bool bDamagedOther = false;
+
+	bool HasAnyOutcome() const { return bBouncedThis || bBouncedOther || bDamagedThis || bDamagedOther; }
+};
+
+//A moment in the recorded hitbox history, given by the two recorded frames around it and how far between them it is.
+//This is resolved once per timestamp and can then be used to read any number of hitboxes at that moment.
+struct FHitboxRewindFrame
+{
+	//Frame numbers of the recorded frames before and after the moment. Frame numbers count up from 0 and never lose precision.
+	//No before frame means the moment is older than the history, and no after frame means it is newer than the newest recorded frame.
+	int64 BeforeFrame = INDEX_NONE;
+	int64 AfterFrame = INDEX_NONE;
+	//Fraction of the way from the before frame to the after frame. This is computed in double precision from the frame times.
+	float Alpha = 0.0f;
+};
+
+//The positions on either side of a batch of rewind queries, with one array per axis so that one vector register holds one axis of four queries.
+//The arrays are padded with zeroes to a whole number of registers, so the last group of four never needs a scalar tail.
+struct HITBOXCORE_API FHitboxLerpBatch
+{
+	TArray<double> BeforeX;
+	TArray<double> BeforeY;
+	TArray<double> BeforeZ;
+	TArray<double> AfterX;
+	TArray<double> AfterY;
+	TArray<double> AfterZ;
+	TArray<double> Alphas;
+
+	static constexpr int32 QueriesPerRegister = 4;
+
+	void SetNum(const int32 NewNum);
+	int32 Num() const { return NumQueries; }
+	void Set(const int32 Query, const FVector& Before, const FVector& After, const float Alpha);
+
+private:
+
+	int32 NumQueries = 0;
+};
+
+namespace HitboxCollision
+{
+	//Performs the actual bounce impulse and damage value calculations based on hitbox locations.
+	//The outcome comes from the interaction table, so this only picks out the impulses and damage values to apply.
+	HITBOXCORE_API void ProcessCollision(const FHitboxCollisionParams& This, const FHitboxCollisionParams& Other, FHitboxCollisionResult& Result);
+
+	//Height another hitbox's bottom must be above to count as landing on top of a hitbox at this height, given half of its vertical extent.
+	inline float GetThresholdHeight(const double LocationZ, const float HalfExtent, const float CollisionThreshold)
+	{
+		return FMath::Lerp(LocationZ - HalfExtent, LocationZ + HalfExtent, CollisionThreshold);
+	}
+
+	//Whether two hitboxes are close enough to be touching, allowing them to be further apart than their combined radii by the multiplier.
+	inline bool AreTouching(const FVector& FirstLocation, const float FirstRadius, const FVector& SecondLocation, const float SecondRadius, const float ToleranceMultiplier)
+	{
+		return FVector::DistSquared(FirstLocation, SecondLocation) <= FMath::Square((FirstRadius + SecondRadius) * ToleranceMultiplier);
+	}
+
+	//Exact circle test in the X/Z plane, which is the only plane hitboxes move in.
+	inline bool AreTouchingInPlane(const FVector& FirstLocation, const float FirstRadius, const FVector& SecondLocation, const float SecondRadius)
+	{
+		const double DeltaX = FirstLocation.X - SecondLocation.X;
+		const double DeltaZ = FirstLocation.Z - SecondLocation.Z;
+		return DeltaX * DeltaX + DeltaZ * DeltaZ <= FMath::Square(FirstRadius + SecondRadius);
+	}
+
+	//Exact test of two hitbox shapes in the X/Z plane. Slack lets the shapes be up to that much further apart and still count as touching.
+	//Pairs of circles take a fast path. Every other pair is tested as two rounded boxes, four lanes at a time.
+	HITBOXCORE_API bool AreShapesTouching(const FVector& FirstLocation, const FHitboxShape2D& FirstShape, const FVector& SecondLocation, const FHitboxShape2D& SecondShape,
+		const float Slack = 0.0f);
+
+	//Replays a reported collision with both hitboxes at the given locations, clearing any outcomes that don't reproduce.
+	//PositionError is how far the given locations may be from where the hitboxes really were, such as the rounding of a quantized history,
+	//and is added to the slack so that rounding can never turn a real hit into a rejected one.
+	HITBOXCORE_API void ReplayCollision(const FHitboxCollisionParams& This, const FHitboxCollisionParams& Other, const float ToleranceMultiplier,
+		const float PositionError, FHitboxCollisionOutcome& Outcome);
+
+	//Swept circle test in the X/Z plane, for two hitboxes moving in straight lines over a frame.
+	//Returns whether they touched at any point during the frame, and how far through the frame they first did.
+	HITBOXCORE_API bool SweepCircles(const FVector& FirstStart, const FVector& FirstEnd, const FVector& SecondStart, const FVector& SecondEnd,
+		const float CombinedRadius, float& OutTimeOfImpact);
+
+	//How far through a frame two shapes moving in straight lines first touched, for shapes known to be touching at the end of the frame.
+	//Bisects between StartTime and the end of the frame, so it is accurate to within a thousandth of the frame. Returns StartTime if they already touch then.
+	HITBOXCORE_API float FindTimeOfImpact(const FVector& FirstStart, const FVector& FirstEnd, const FHitboxShape2D& FirstShape,
+		const FVector& SecondStart, const FVector& SecondEnd, const FHitboxShape2D& SecondShape, const float StartTime = 0.0f);
+
+	//Binary search for the recorded frames on either side of the timestamp, in a ring of frame times where frame N lives in entry N % the ring's size.
+	//CurrentTime is used as the time of the after frame when the timestamp is newer than anything recorded.
+	HITBOXCORE_API FHitboxRewindFrame FindRewindFrame(TConstArrayView<double> RingFrameTimes, const int64 OldestFrame, const int32 NumFrames,
+		const double Timestamp, const double CurrentTime);
+
+	//Interpolates every query in the batch, four at a time, with each axis of four queries in one register.
+	HITBOXCORE_API void LerpPositions(const FHitboxLerpBatch& Batch, TArrayView<FVector> OutPositions);
+	//Interpolates every query in the batch one at a time with scalar math. This is what LerpPositions is measured against.
+	HITBOXCORE_API void LerpPositionsScalar(const FHitboxLerpBatch& Batch, TArrayView<FVector> OutPositions);
+
+	//Lerps all three components of one position in one register instead of one at a time.
+	inline FVector LerpPosition(const FVector& Before, const FVector& After, const float Alpha)
+	{
+		FVector Position;
+		const VectorRegister4Double BeforeRegister = VectorLoadFloat3(&Before.X);
+		const VectorRegister4Double AfterRegister = VectorLoadFloat3(&After.X);
+		const VectorRegister4Double AlphaRegister = VectorSetFloat1(static_cast<double>(Alpha));
+		VectorStoreFloat3(VectorMultiplyAdd(VectorSubtract(AfterRegister, BeforeRegister), AlphaRegister, BeforeRegister), &Position.X);
+		return Position;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+using UnrealBuildTool;
+
+//Headless benchmark of the hitbox collision math. It only links Core and HitboxCore, so it runs without the engine, a world or a renderer.
+public class HitboxCoreBenchmarkTarget : TargetRules
+{
+	public HitboxCoreBenchmarkTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Program;
+		LinkType = TargetLinkType.Monolithic;
+		DefaultBuildSettings = BuildSettingsVersion.V4;
+		IncludeOrderVersion = EngineIncludeOrderVersion.Unreal5_3;
+		LaunchModuleName = "HitboxCoreBenchmark";
+
+		bBuildDeveloperTools = false;
+		bCompileAgainstEngine = false;
+		bCompileAgainstCoreUObject = false;
+		bCompileAgainstApplicationCore = false;
+		bCompileICU = false;
+		bUseLoggingInShipping = true;
+		bIsBuildingConsoleApplication = true;
+	}
+}
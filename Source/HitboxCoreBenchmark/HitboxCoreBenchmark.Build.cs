@@ -0,0 +1,13 @@
+using UnrealBuildTool;
+
+public class HitboxCoreBenchmark : ModuleRules
+{
+	public HitboxCoreBenchmark(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PrivateDependencyModuleNames.AddRange(new string[] { "Core", "Projects", "HitboxCore" });
+		//For RequiredProgramMainCPPInclude.h.
+		PrivateIncludePathModuleNames.Add("Launch");
+	}
+}
@@ -0,0 +1,230 @@
+﻿#include "RequiredProgramMainCPPInclude.h"
+#include "HitboxCollision.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+
+IMPLEMENT_APPLICATION(HitboxCoreBenchmark, "HitboxCoreBenchmark");
+
+namespace
+{
+	struct FBenchmarkResult
+	{
+		FString Name;
+		int32 NumCalls = 0;
+		double Seconds = 0.0;
+	};
+
+	//Runs the benchmark once to warm the caches, then times it. The benchmark returns a count of its results so that none of the work can be optimized away.
+	FBenchmarkResult Measure(const TCHAR* Name, const int32 NumCalls, TFunctionRef<int32()> Benchmark)
+	{
+		int32 Checksum = Benchmark();
+		const double StartTime = FPlatformTime::Seconds();
+		Checksum += Benchmark();
+		FBenchmarkResult Result;
+		Result.Name = Name;
+		Result.NumCalls = NumCalls;
+		Result.Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, UE_DOUBLE_SMALL_NUMBER);
+		UE_LOG(LogTemp, Display, TEXT("%s: %.1f ns per call over %d calls (checksum %d)."), Name, Result.Seconds * 1.0e9 / NumCalls, NumCalls, Checksum);
+		return Result;
+	}
+
+	FHitboxCollisionParams MakeRandomParams(FRandomStream& Stream)
+	{
+		FHitboxCollisionParams Params;
+		Params.Radius = Stream.FRandRange(20.0f, 60.0f);
+		Params.Shape = FHitboxShape2D::MakeCircle(Params.Radius);
+		Params.Location = FVector(Stream.FRandRange(-100.0f, 100.0f), 0.0f, Stream.FRandRange(-100.0f, 100.0f));
+		Params.Capabilities = static_cast<EHitboxCapabilities>(Stream.RandRange(0, HitboxInteractions::NumCapabilityMasks - 1));
+		Params.BounceImpulse = FVector(0.0, 0.0, 800.0);
+		Params.CollisionDamage = 1.0f;
+		return Params;
+	}
+
+	const TCHAR* GetShapeName(const int32 ShapeType)
+	{
+		return ShapeType == 0 ? TEXT("Circle") : ShapeType == 1 ? TEXT("Capsule") : TEXT("Box");
+	}
+
+	FHitboxShape2D MakeRandomShape(const int32 ShapeType, FRandomStream& Stream)
+	{
+		const float Angle = Stream.FRandRange(-UE_PI, UE_PI);
+		switch (ShapeType)
+		{
+		case 0:
+			return FHitboxShape2D::MakeCircle(Stream.FRandRange(20.0f, 60.0f));
+		case 1:
+			return FHitboxShape2D::MakeCapsule(Stream.FRandRange(20.0f, 40.0f), Stream.FRandRange(50.0f, 100.0f), Angle);
+		default:
+			return FHitboxShape2D::MakeBox(Stream.FRandRange(20.0f, 80.0f), Stream.FRandRange(20.0f, 80.0f), Angle);
+		}
+	}
+}
+
+//Times each of the hitbox collision functions on a fixed set of random inputs and logs the time per call.
+//-Calls=N sets how many calls each benchmark makes, and -Csv=Path also writes the results to a CSV file.
+INT32_MAIN_INT32_ARGC_TCHAR_ARGV()
+{
+	FTaskTagScope Scope(ETaskTag::EGameThread);
+	ON_SCOPE_EXIT
+	{
+		FEngineLoop::AppPreExit();
+		FEngineLoop::AppExit();
+	};
+	if (const int32 Result = GEngineLoop.PreInit(ArgC, ArgV))
+	{
+		return Result;
+	}
+
+	int32 NumCalls = 1000000;
+	FParse::Value(FCommandLine::Get(), TEXT("-Calls="), NumCalls);
+	NumCalls = FMath::Max(NumCalls, 1);
+	//The same seed for every run, so that results can be compared between builds.
+	FRandomStream Stream(NumCalls);
+	TArray<FBenchmarkResult> Results;
+
+	TArray<FHitboxCollisionParams> First;
+	TArray<FHitboxCollisionParams> Second;
+	First.Reserve(NumCalls);
+	Second.Reserve(NumCalls);
+	for (int32 Call = 0; Call < NumCalls; Call++)
+	{
+		First.Add(MakeRandomParams(Stream));
+		Second.Add(MakeRandomParams(Stream));
+	}
+	Results.Add(Measure(TEXT("ProcessCollision"), NumCalls, [&]()
+	{
+		int32 NumHits = 0;
+		for (int32 Call = 0; Call < NumCalls; Call++)
+		{
+			FHitboxCollisionResult Result;
+			HitboxCollision::ProcessCollision(First[Call], Second[Call], Result);
+			NumHits += Result.DamageToThis != 0.0f || Result.DamageToOther != 0.0f ? 1 : 0;
+		}
+		return NumHits;
+	}));
+	Results.Add(Measure(TEXT("ReplayCollision"), NumCalls, [&]()
+	{
+		int32 NumKept = 0;
+		for (int32 Call = 0; Call < NumCalls; Call++)
+		{
+			FHitboxCollisionOutcome Outcome;
+			Outcome.bBouncedThis = true;
+			Outcome.bDamagedOther = true;
+			HitboxCollision::ReplayCollision(First[Call], Second[Call], 1.25f, 0.0f, Outcome);
+			NumKept += Outcome.HasAnyOutcome() ? 1 : 0;
+		}
+		return NumKept;
+	}));
+
+	TArray<FVector> Ends;
+	Ends.Reserve(NumCalls);
+	for (int32 Call = 0; Call < NumCalls; Call++)
+	{
+		Ends.Add(First[Call].Location + FVector(Stream.FRandRange(-50.0f, 50.0f), 0.0f, Stream.FRandRange(-50.0f, 50.0f)));
+	}
+	Results.Add(Measure(TEXT("SweepCircles"), NumCalls, [&]()
+	{
+		int32 NumHits = 0;
+		for (int32 Call = 0; Call < NumCalls; Call++)
+		{
+			float TimeOfImpact = 0.0f;
+			NumHits += HitboxCollision::SweepCircles(First[Call].Location, Ends[Call], Second[Call].Location, Second[Call].Location,
+				First[Call].Radius + Second[Call].Radius, TimeOfImpact) ? 1 : 0;
+		}
+		return NumHits;
+	}));
+
+	//A full ring of a second of frames at 60Hz that has wrapped around, queried at random moments up to half a second ago.
+	static constexpr int32 RingSize = 64;
+	static constexpr int32 NumFrames = 60;
+	static constexpr int64 OldestFrame = 1000;
+	TArray<double> RingFrameTimes;
+	RingFrameTimes.SetNumZeroed(RingSize);
+	for (int64 Frame = OldestFrame; Frame < OldestFrame + NumFrames; Frame++)
+	{
+		RingFrameTimes[static_cast<int32>(Frame % RingSize)] = Frame / 60.0;
+	}
+	const double CurrentTime = (OldestFrame + NumFrames) / 60.0;
+	TArray<double> Timestamps;
+	Timestamps.Reserve(NumCalls);
+	for (int32 Call = 0; Call < NumCalls; Call++)
+	{
+		Timestamps.Add(CurrentTime - Stream.FRandRange(0.0f, 0.5f));
+	}
+	Results.Add(Measure(TEXT("FindRewindFrame"), NumCalls, [&]()
+	{
+		int32 NumInterpolated = 0;
+		for (int32 Call = 0; Call < NumCalls; Call++)
+		{
+			const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(RingFrameTimes, OldestFrame, NumFrames, Timestamps[Call], CurrentTime);
+			NumInterpolated += RewindFrame.BeforeFrame != INDEX_NONE ? 1 : 0;
+		}
+		return NumInterpolated;
+	}));
+
+	FHitboxLerpBatch Batch;
+	Batch.SetNum(NumCalls);
+	for (int32 Call = 0; Call < NumCalls; Call++)
+	{
+		Batch.Set(Call, First[Call].Location, Ends[Call], Stream.FRand());
+	}
+	TArray<FVector> Positions;
+	Positions.SetNumZeroed(NumCalls);
+	Results.Add(Measure(TEXT("LerpPositions"), NumCalls, [&]()
+	{
+		HitboxCollision::LerpPositions(Batch, Positions);
+		return static_cast<int32>(Positions.Last().X);
+	}));
+	Results.Add(Measure(TEXT("LerpPositionsScalar"), NumCalls, [&]()
+	{
+		HitboxCollision::LerpPositionsScalar(Batch, Positions);
+		return static_cast<int32>(Positions.Last().X);
+	}));
+
+	//The narrowphase for every pair of shape types, on random placements where about half of the pairs touch.
+	for (int32 FirstType = 0; FirstType < 3; FirstType++)
+	{
+		for (int32 SecondType = FirstType; SecondType < 3; SecondType++)
+		{
+			TArray<FHitboxShape2D> FirstShapes;
+			TArray<FHitboxShape2D> SecondShapes;
+			TArray<FVector> Offsets;
+			FirstShapes.Reserve(NumCalls);
+			SecondShapes.Reserve(NumCalls);
+			Offsets.Reserve(NumCalls);
+			for (int32 Call = 0; Call < NumCalls; Call++)
+			{
+				FirstShapes.Add(MakeRandomShape(FirstType, Stream));
+				SecondShapes.Add(MakeRandomShape(SecondType, Stream));
+				Offsets.Add(FVector(Stream.FRandRange(-200.0f, 200.0f), 0.0f, Stream.FRandRange(-200.0f, 200.0f)));
+			}
+			const FString Name = FString::Printf(TEXT("AreShapesTouching %s vs %s"), GetShapeName(FirstType), GetShapeName(SecondType));
+			Results.Add(Measure(*Name, NumCalls, [&]()
+			{
+				int32 NumTouching = 0;
+				for (int32 Call = 0; Call < NumCalls; Call++)
+				{
+					NumTouching += HitboxCollision::AreShapesTouching(FVector::ZeroVector, FirstShapes[Call], Offsets[Call], SecondShapes[Call]) ? 1 : 0;
+				}
+				return NumTouching;
+			}));
+		}
+	}
+
+	FString CsvPath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-Csv="), CsvPath))
+	{
+		FString Csv = TEXT("Benchmark,Calls,Seconds,NsPerCall\n");
+		for (const FBenchmarkResult& Result : Results)
+		{
+			Csv += FString::Printf(TEXT("%s,%d,%.6f,%.2f\n"), *Result.Name, Result.NumCalls, Result.Seconds, Result.Seconds * 1.0e9 / Result.NumCalls);
+		}
+		if (!FFileHelper::SaveStringToFile(Csv, *CsvPath))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Couldn't write the benchmark results to %s."), *CsvPath);
+			return 1;
+		}
+		UE_LOG(LogTemp, Display, TEXT("Wrote the benchmark results to %s."), *CsvPath);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+using UnrealBuildTool;
+
+//Low level tests for the hitbox collision math. HitboxCore only depends on Core, so the test executable is built without the engine or UObjects.
+//Build the HitboxCoreTests target and run the resulting executable directly, or through RunLowLevelTests.
+[SupportedPlatforms(UnrealPlatformClass.All)]
+public class HitboxCoreTestsTarget : TestTargetRules
+{
+	public HitboxCoreTestsTarget(TargetInfo Target) : base(Target)
+	{
+		DefaultBuildSettings = BuildSettingsVersion.V4;
+		IncludeOrderVersion = EngineIncludeOrderVersion.Unreal5_3;
+		LaunchModuleName = "HitboxCoreTests";
+
+		bCompileAgainstEngine = false;
+		bCompileAgainstCoreUObject = false;
+		bCompileAgainstApplicationCore = false;
+	}
+}
@@ -0,0 +1,11 @@
+using UnrealBuildTool;
+
+public class HitboxCoreTests : TestModuleRules
+{
+	public HitboxCoreTests(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PrivateDependencyModuleNames.AddRange(new string[] { "Core", "HitboxCore" });
+	}
+}
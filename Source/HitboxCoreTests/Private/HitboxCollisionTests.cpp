@@ -0,0 +1,312 @@
+﻿#include "HitboxCollision.h"
+#include "TestHarness.h"
+
+namespace HitboxCollisionTests
+{
+	FHitboxCollisionParams MakeCircleParams(const FVector& Location, const float Radius, const EHitboxCapabilities Capabilities,
+		const FVector& BounceImpulse = FVector::ZeroVector, const float CollisionDamage = 0.0f)
+	{
+		FHitboxCollisionParams Params;
+		Params.Location = Location;
+		Params.Radius = Radius;
+		Params.Shape = FHitboxShape2D::MakeCircle(Radius);
+		Params.Capabilities = Capabilities;
+		Params.BounceImpulse = BounceImpulse;
+		Params.CollisionDamage = CollisionDamage;
+		return Params;
+	}
+
+	//A player that stomps enemies, and an enemy that bounces players and hurts them from the side.
+	const EHitboxCapabilities PlayerCapabilities = EHitboxCapabilities::CanBeBounced | EHitboxCapabilities::DealsDamage | EHitboxCapabilities::CanBeDamaged;
+	const EHitboxCapabilities EnemyCapabilities = EHitboxCapabilities::Bouncy | EHitboxCapabilities::CanBeDamaged | EHitboxCapabilities::DealsDamage;
+	const FVector EnemyBounce(0.0, 0.0, 800.0);
+	static constexpr float PlayerDamage = 1.0f;
+	static constexpr float EnemyDamage = 2.0f;
+}
+
+TEST_CASE("HitboxCore::ProcessCollision", "[HitboxCore]")
+{
+	using namespace HitboxCollisionTests;
+	const FHitboxCollisionParams Enemy = MakeCircleParams(FVector::ZeroVector, 50.0f, EnemyCapabilities, EnemyBounce, EnemyDamage);
+
+	SECTION("Landing on top bounces the player and damages the enemy")
+	{
+		//The player's bottom is at 50, above the enemy's threshold at 25.
+		const FHitboxCollisionParams Player = MakeCircleParams(FVector(0.0, 0.0, 100.0), 50.0f, PlayerCapabilities, FVector::ZeroVector, PlayerDamage);
+		FHitboxCollisionResult Result;
+		HitboxCollision::ProcessCollision(Player, Enemy, Result);
+		CHECK(Result.ImpulseToThis == EnemyBounce);
+		CHECK(Result.DamageToOther == PlayerDamage);
+		CHECK(Result.DamageToThis == 0.0f);
+		CHECK(Result.ImpulseToOther.IsZero());
+	}
+
+	SECTION("Running into the side damages the player")
+	{
+		const FHitboxCollisionParams Player = MakeCircleParams(FVector(90.0, 0.0, 0.0), 50.0f, PlayerCapabilities, FVector::ZeroVector, PlayerDamage);
+		FHitboxCollisionResult Result;
+		HitboxCollision::ProcessCollision(Player, Enemy, Result);
+		CHECK(Result.DamageToThis == EnemyDamage);
+		CHECK(Result.DamageToOther == 0.0f);
+		CHECK(Result.ImpulseToThis.IsZero());
+	}
+
+	SECTION("Hitboxes without capabilities don't interact")
+	{
+		const FHitboxCollisionParams Neutral = MakeCircleParams(FVector(0.0, 0.0, 100.0), 50.0f, EHitboxCapabilities::None);
+		FHitboxCollisionResult Result;
+		HitboxCollision::ProcessCollision(Neutral, Enemy, Result);
+		CHECK(Result.ImpulseToThis.IsZero());
+		CHECK(Result.ImpulseToOther.IsZero());
+		CHECK(Result.DamageToThis == 0.0f);
+		CHECK(Result.DamageToOther == 0.0f);
+	}
+}
+
+TEST_CASE("HitboxCore::ReplayCollision", "[HitboxCore]")
+{
+	using namespace HitboxCollisionTests;
+	const FHitboxCollisionParams Enemy = MakeCircleParams(FVector::ZeroVector, 50.0f, EnemyCapabilities, EnemyBounce, EnemyDamage);
+	FHitboxCollisionOutcome Stomp;
+	Stomp.bBouncedThis = true;
+	Stomp.bDamagedOther = true;
+
+	SECTION("A stomp that reproduces is kept")
+	{
+		const FHitboxCollisionParams Player = MakeCircleParams(FVector(0.0, 0.0, 100.0), 50.0f, PlayerCapabilities, FVector::ZeroVector, PlayerDamage);
+		FHitboxCollisionOutcome Outcome = Stomp;
+		HitboxCollision::ReplayCollision(Player, Enemy, 1.0f, 0.0f, Outcome);
+		CHECK(Outcome.bBouncedThis);
+		CHECK(Outcome.bDamagedOther);
+	}
+
+	SECTION("Outcomes that don't reproduce are cleared")
+	{
+		const FHitboxCollisionParams Player = MakeCircleParams(FVector(0.0, 0.0, 100.0), 50.0f, PlayerCapabilities, FVector::ZeroVector, PlayerDamage);
+		FHitboxCollisionOutcome Outcome = Stomp;
+		Outcome.bDamagedThis = true;
+		HitboxCollision::ReplayCollision(Player, Enemy, 1.0f, 0.0f, Outcome);
+		CHECK(Outcome.bBouncedThis);
+		CHECK_FALSE(Outcome.bDamagedThis);
+	}
+
+	SECTION("Hitboxes out of reach clear every outcome")
+	{
+		const FHitboxCollisionParams Player = MakeCircleParams(FVector(0.0, 0.0, 130.0), 50.0f, PlayerCapabilities, FVector::ZeroVector, PlayerDamage);
+		FHitboxCollisionOutcome Outcome = Stomp;
+		HitboxCollision::ReplayCollision(Player, Enemy, 1.25f, 0.0f, Outcome);
+		CHECK_FALSE(Outcome.HasAnyOutcome());
+	}
+
+	SECTION("Position error is added to the slack")
+	{
+		//Half a unit further apart than the combined radii.
+		const FHitboxCollisionParams Player = MakeCircleParams(FVector(0.0, 0.0, 100.5), 50.0f, PlayerCapabilities, FVector::ZeroVector, PlayerDamage);
+		FHitboxCollisionOutcome Exact = Stomp;
+		HitboxCollision::ReplayCollision(Player, Enemy, 1.0f, 0.0f, Exact);
+		CHECK_FALSE(Exact.HasAnyOutcome());
+		FHitboxCollisionOutcome WithError = Stomp;
+		HitboxCollision::ReplayCollision(Player, Enemy, 1.0f, 1.0f, WithError);
+		CHECK(WithError.bBouncedThis);
+		CHECK(WithError.bDamagedOther);
+	}
+}
+
+TEST_CASE("HitboxCore::SweepCircles", "[HitboxCore]")
+{
+	float TimeOfImpact = -1.0f;
+
+	SECTION("Passing through finds the first moment of contact")
+	{
+		//Relative to the second circle, the first moves from -200 to 200 along X and first touches at -100.
+		REQUIRE(HitboxCollision::SweepCircles(FVector(-200.0, 0.0, 0.0), FVector(200.0, 0.0, 0.0), FVector::ZeroVector, FVector::ZeroVector, 100.0f, TimeOfImpact));
+		CHECK(FMath::IsNearlyEqual(TimeOfImpact, 0.25f, 0.0001f));
+	}
+
+	SECTION("Both moving is the same as one moving relative to the other")
+	{
+		REQUIRE(HitboxCollision::SweepCircles(FVector(-100.0, 0.0, 0.0), FVector(100.0, 0.0, 0.0), FVector(100.0, 0.0, 0.0), FVector(-100.0, 0.0, 0.0), 100.0f, TimeOfImpact));
+		CHECK(FMath::IsNearlyEqual(TimeOfImpact, 0.25f, 0.0001f));
+	}
+
+	SECTION("Already touching at the start is a time of impact of zero")
+	{
+		REQUIRE(HitboxCollision::SweepCircles(FVector(-50.0, 0.0, 0.0), FVector(-60.0, 0.0, 0.0), FVector::ZeroVector, FVector::ZeroVector, 100.0f, TimeOfImpact));
+		CHECK(TimeOfImpact == 0.0f);
+	}
+
+	SECTION("Moving apart or passing wide never touches")
+	{
+		CHECK_FALSE(HitboxCollision::SweepCircles(FVector(-200.0, 0.0, 0.0), FVector(-400.0, 0.0, 0.0), FVector::ZeroVector, FVector::ZeroVector, 100.0f, TimeOfImpact));
+		CHECK_FALSE(HitboxCollision::SweepCircles(FVector(-200.0, 0.0, 150.0), FVector(200.0, 0.0, 150.0), FVector::ZeroVector, FVector::ZeroVector, 100.0f, TimeOfImpact));
+		//Stopping short of contact.
+		CHECK_FALSE(HitboxCollision::SweepCircles(FVector(-300.0, 0.0, 0.0), FVector(-150.0, 0.0, 0.0), FVector::ZeroVector, FVector::ZeroVector, 100.0f, TimeOfImpact));
+	}
+
+	SECTION("Y is ignored, since hitboxes only move in the X/Z plane")
+	{
+		REQUIRE(HitboxCollision::SweepCircles(FVector(-200.0, 500.0, 0.0), FVector(200.0, 500.0, 0.0), FVector::ZeroVector, FVector::ZeroVector, 100.0f, TimeOfImpact));
+		CHECK(FMath::IsNearlyEqual(TimeOfImpact, 0.25f, 0.0001f));
+	}
+}
+
+TEST_CASE("HitboxCore::FindRewindFrame", "[HitboxCore]")
+{
+	SECTION("An empty history has no frames on either side")
+	{
+		const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(TConstArrayView<double>(), 0, 0, 1.0, 2.0);
+		CHECK(RewindFrame.BeforeFrame == INDEX_NONE);
+		CHECK(RewindFrame.AfterFrame == INDEX_NONE);
+		const double RingTimes[4] = { 0.0, 0.0, 0.0, 0.0 };
+		const FHitboxRewindFrame NoFrames = HitboxCollision::FindRewindFrame(RingTimes, 0, 0, 1.0, 2.0);
+		CHECK(NoFrames.BeforeFrame == INDEX_NONE);
+		CHECK(NoFrames.AfterFrame == INDEX_NONE);
+	}
+
+	//Frames 6 to 9 in a ring of four, so that the oldest frame is in the middle of the ring and the history wraps around its end.
+	//Each frame's time is its frame number.
+	const double RingTimes[4] = { 8.0, 9.0, 6.0, 7.0 };
+	static constexpr int64 OldestFrame = 6;
+	static constexpr int32 NumFrames = 4;
+	static constexpr double CurrentTime = 10.0;
+
+	SECTION("Timestamps between frames interpolate between them")
+	{
+		const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(RingTimes, OldestFrame, NumFrames, 7.25, CurrentTime);
+		CHECK(RewindFrame.BeforeFrame == 7);
+		CHECK(RewindFrame.AfterFrame == 8);
+		CHECK(FMath::IsNearlyEqual(RewindFrame.Alpha, 0.25f));
+	}
+
+	SECTION("Frames on either side of the ring's wraparound are found")
+	{
+		const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(RingTimes, OldestFrame, NumFrames, 8.5, CurrentTime);
+		CHECK(RewindFrame.BeforeFrame == 8);
+		CHECK(RewindFrame.AfterFrame == 9);
+		CHECK(FMath::IsNearlyEqual(RewindFrame.Alpha, 0.5f));
+	}
+
+	SECTION("A timestamp exactly on a frame lands on that frame")
+	{
+		const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(RingTimes, OldestFrame, NumFrames, 8.0, CurrentTime);
+		CHECK(RewindFrame.BeforeFrame == 7);
+		CHECK(RewindFrame.AfterFrame == 8);
+		CHECK(RewindFrame.Alpha == 1.0f);
+	}
+
+	SECTION("Timestamps older than the history clamp to the oldest frame")
+	{
+		const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(RingTimes, OldestFrame, NumFrames, 2.0, CurrentTime);
+		CHECK(RewindFrame.BeforeFrame == INDEX_NONE);
+		CHECK(RewindFrame.AfterFrame == OldestFrame);
+	}
+
+	SECTION("Timestamps newer than the history interpolate towards the current time")
+	{
+		const FHitboxRewindFrame RewindFrame = HitboxCollision::FindRewindFrame(RingTimes, OldestFrame, NumFrames, 9.5, CurrentTime);
+		CHECK(RewindFrame.BeforeFrame == 9);
+		CHECK(RewindFrame.AfterFrame == INDEX_NONE);
+		CHECK(FMath::IsNearlyEqual(RewindFrame.Alpha, 0.5f));
+	}
+}
+
+TEST_CASE("HitboxCore::AreShapesTouching", "[HitboxCore]")
+{
+	const FHitboxShape2D Circle = FHitboxShape2D::MakeCircle(10.0f);
+
+	SECTION("Circles")
+	{
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Circle, FVector(19.0, 0.0, 0.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Circle, FVector(21.0, 0.0, 0.0), Circle));
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Circle, FVector(21.0, 0.0, 0.0), Circle, 2.0f));
+	}
+
+	SECTION("Boxes have sharp corners")
+	{
+		const FHitboxShape2D Box = FHitboxShape2D::MakeBox(50.0f, 10.0f, 0.0f);
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Box, FVector(55.0, 0.0, 0.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Box, FVector(61.0, 0.0, 0.0), Circle));
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Box, FVector(61.0, 0.0, 0.0), Circle, 2.0f));
+		//Just inside the corner's reach, and then inside the box's bounds grown by the circle's radius but still out of the corner's reach.
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Box, FVector(57.0, 0.0, 17.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Box, FVector(58.0, 0.0, 18.0), Circle));
+	}
+
+	SECTION("Rotated boxes")
+	{
+		const FHitboxShape2D Upright = FHitboxShape2D::MakeBox(50.0f, 10.0f, UE_HALF_PI);
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Upright, FVector(55.0, 0.0, 0.0), Circle));
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Upright, FVector(0.0, 0.0, 55.0), Circle));
+		//Two thin boxes crossed like an X touch in the middle, even though neither contains the other's center.
+		const FHitboxShape2D Diagonal = FHitboxShape2D::MakeBox(50.0f, 1.0f, UE_PI / 4.0f);
+		const FHitboxShape2D OtherDiagonal = FHitboxShape2D::MakeBox(50.0f, 1.0f, -UE_PI / 4.0f);
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Diagonal, FVector(0.0, 0.0, 20.0), OtherDiagonal));
+	}
+
+	SECTION("Capsules")
+	{
+		//A capsule's half height includes its caps, so this one's segment runs from -40 to 40 along Z.
+		const FHitboxShape2D Capsule = FHitboxShape2D::MakeCapsule(10.0f, 50.0f, 0.0f);
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Capsule, FVector(0.0, 0.0, 55.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Capsule, FVector(0.0, 0.0, 65.0), Circle));
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Capsule, FVector(15.0, 0.0, 0.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, Capsule, FVector(25.0, 0.0, 0.0), Circle));
+	}
+
+	SECTION("Locations far from the origin")
+	{
+		const FHitboxShape2D Box = FHitboxShape2D::MakeBox(50.0f, 10.0f, 0.0f);
+		const FVector Far(10000000.0, 0.0, -10000000.0);
+		CHECK(HitboxCollision::AreShapesTouching(Far, Box, Far + FVector(55.0, 0.0, 0.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(Far, Box, Far + FVector(61.0, 0.0, 0.0), Circle));
+	}
+
+	SECTION("Negative sizes from a mirrored scale make the same shape")
+	{
+		const FHitboxShape2D Box = FHitboxShape2D::MakeBox(50.0f, 10.0f, 0.0f);
+		const FHitboxShape2D MirroredBox = FHitboxShape2D::MakeBox(-50.0f, -10.0f, 0.0f);
+		CHECK(MirroredBox.HalfWidth == Box.HalfWidth);
+		CHECK(MirroredBox.HalfHeight == Box.HalfHeight);
+		CHECK(HitboxCollision::AreShapesTouching(FVector::ZeroVector, MirroredBox, FVector(-55.0, 0.0, 0.0), Circle));
+		CHECK_FALSE(HitboxCollision::AreShapesTouching(FVector::ZeroVector, MirroredBox, FVector(-61.0, 0.0, 0.0), Circle));
+		const FHitboxShape2D Capsule = FHitboxShape2D::MakeCapsule(10.0f, 50.0f, 0.0f);
+		const FHitboxShape2D MirroredCapsule = FHitboxShape2D::MakeCapsule(-10.0f, -50.0f, 0.0f);
+		CHECK(MirroredCapsule.Rounding == Capsule.Rounding);
+		CHECK(MirroredCapsule.HalfHeight == Capsule.HalfHeight);
+		CHECK(MirroredCapsule.GetBoundingRadius() == Capsule.GetBoundingRadius());
+		CHECK(FHitboxShape2D::MakeCircle(-10.0f).Rounding == Circle.Rounding);
+	}
+}
+
+TEST_CASE("HitboxCore::FindTimeOfImpact", "[HitboxCore]")
+{
+	const FHitboxShape2D Box = FHitboxShape2D::MakeBox(50.0f, 10.0f, 0.0f);
+	const FHitboxShape2D Circle = FHitboxShape2D::MakeCircle(10.0f);
+	//The circle moves from 100 to 0 along X and first touches the box's side at 60.
+	const float TimeOfImpact = HitboxCollision::FindTimeOfImpact(FVector::ZeroVector, FVector::ZeroVector, Box, FVector(100.0, 0.0, 0.0), FVector::ZeroVector, Circle);
+	CHECK(FMath::IsNearlyEqual(TimeOfImpact, 0.4f, 0.002f));
+	CHECK(HitboxCollision::FindTimeOfImpact(FVector::ZeroVector, FVector::ZeroVector, Box, FVector(55.0, 0.0, 0.0), FVector::ZeroVector, Circle) == 0.0f);
+}
+
+TEST_CASE("HitboxCore::LerpPositions", "[HitboxCore]")
+{
+	//An odd number of queries, so that the last register is only partly used.
+	FHitboxLerpBatch Batch;
+	Batch.SetNum(7);
+	for (int32 Query = 0; Query < Batch.Num(); Query++)
+	{
+		Batch.Set(Query, FVector(Query, -Query, Query * 10.0), FVector(Query + 100.0, Query * 2.0, -Query), Query / 6.0f);
+	}
+	TArray<FVector> Vector;
+	TArray<FVector> Scalar;
+	Vector.SetNumZeroed(Batch.Num());
+	Scalar.SetNumZeroed(Batch.Num());
+	HitboxCollision::LerpPositions(Batch, Vector);
+	HitboxCollision::LerpPositionsScalar(Batch, Scalar);
+	for (int32 Query = 0; Query < Batch.Num(); Query++)
+	{
+		CHECK(Vector[Query].Equals(Scalar[Query], UE_DOUBLE_KINDA_SMALL_NUMBER));
+	}
+	CHECK(Vector[0].Equals(FVector::ZeroVector));
+	CHECK(Vector[6].Equals(FVector(106.0, 12.0, -6.0), UE_DOUBLE_KINDA_SMALL_NUMBER));
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "MarioPlayerCharacter.h"
 #include "PaperSpriteComponent.h"
+#include "TriggerRegionManager.h"
 #include "Components/SphereComponent.h"
 #include "Net/UnrealNetwork.h"
 
@@ -35,7 +36,14 @@ void ACollectible::BeginPlay()
 
 	if (HasAuthority())
 	{
-		if (IsValid(CollisionSphere))
+		TriggerManager = GetWorld()->GetSubsystem<UTriggerRegionManager>();
+		if (IsValid(TriggerManager) && TriggerManager->IsUsingRegionGrid())
+		{
+			//The collision sphere stays at NoCollision, the region does the overlap testing.
+			TriggerRegionID = TriggerManager->RegisterSphereRegion(CollisionSphere->GetComponentLocation(), CollisionSphere->GetScaledSphereRadius(),
+				FTriggerRegionCallback::CreateUObject(this, &ACollectible::OnRegionEntered));
+		}
+		else if (IsValid(CollisionSphere))
 		{
 			CollisionSphere->OnComponentBeginOverlap.AddDynamic(this, &ACollectible::OnOverlap);
 			CollisionSphere->SetCollisionProfileName(CollectibleProfile);
@@ -53,6 +61,19 @@ void ACollectible::BeginPlay()
 	}
 }
 
+void ACollectible::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (TriggerRegionID != INDEX_NONE)
+	{
+		if (IsValid(TriggerManager))
+		{
+			TriggerManager->UnregisterRegion(TriggerRegionID);
+		}
+		TriggerRegionID = INDEX_NONE;
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 void ACollectible::OnGameStateSet(AGameStateBase* GameState)
 {
 	GameStateRef = Cast<AMarioGameState>(GameState);
@@ -68,7 +89,11 @@ void ACollectible::OnGameStarted()
 {
 	if (bCollected)
 	{
-		if (IsValid(CollisionSphere))
+		if (TriggerRegionID != INDEX_NONE)
+		{
+			TriggerManager->SetRegionEnabled(TriggerRegionID, true);
+		}
+		else if (IsValid(CollisionSphere))
 		{
 			CollisionSphere->SetCollisionProfileName(CollectibleProfile);
 		}
@@ -79,12 +104,21 @@ void ACollectible::OnGameStarted()
 
 void ACollectible::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
-	AMarioPlayerCharacter* OverlappingPlayer = Cast<AMarioPlayerCharacter>(OtherActor);
+	Collect(OtherActor);
+}
+
+void ACollectible::Collect(AActor* Actor)
+{
+	AMarioPlayerCharacter* OverlappingPlayer = Cast<AMarioPlayerCharacter>(Actor);
 	if (IsValid(OverlappingPlayer))
 	{
 		OverlappingPlayer->GrantCollectible(CollectibleValue);
 		bCollected = true;
-		if (IsValid(CollisionSphere))
+		if (TriggerRegionID != INDEX_NONE)
+		{
+			TriggerManager->SetRegionEnabled(TriggerRegionID, false);
+		}
+		else if (IsValid(CollisionSphere))
 		{
 			CollisionSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 		}
@@ -98,4 +132,9 @@ void ACollectible::OnRep_bCollected()
 	{
 		Sprite->SetVisibility(!bCollected);
 	}
+}
+
+void ACollectible::OnRegionEntered(APawn* Pawn)
+{
+	Collect(Pawn);
 }
\ No newline at end of file
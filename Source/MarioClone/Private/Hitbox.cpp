@@ -1,9 +1,20 @@
 ﻿#include "Hitbox.h"
 #include "HitboxManager.h"
-#include "MarioPlayerCharacter.h"
+#include "Engine/CollisionProfile.h"
+#include "HAL/IConsoleManager.h"
 #include "Net/UnrealNetwork.h"
 
-const FName UHitbox::HitboxProfile = FName(TEXT("Hitbox"));
+const FName UHitbox::NeutralHitboxProfile = FName(TEXT("Hitbox"));
+const FName UHitbox::EnemyHitboxProfile = FName(TEXT("EnemyHitbox"));
+const FName UHitbox::AllyHitboxProfile = FName(TEXT("AllyHitbox"));
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Overlap Events"), STAT_HitboxOverlapEvents, STATGROUP_Hitboxes);
+
+static TAutoConsoleVariable<bool> CVarUseHostilityProfiles(
+	TEXT("Hitboxes.UseHostilityProfiles"),
+	true,
+	TEXT("Give each hostility its own hitbox channel, so that physics never reports overlaps between hitboxes of the same hostility. ")
+	TEXT("When off, every hitbox overlaps every other, for comparing overlap event counts. Takes effect for hitboxes initialized afterwards."));
 
 #pragma region Core
 
@@ -19,6 +30,7 @@ void UHitbox::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeP
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	DOREPLIFETIME(UHitbox, HitboxID);
+	DOREPLIFETIME_CONDITION(UHitbox, ArchetypeIndex, COND_InitialOnly);
 }
 
 void UHitbox::InitializeComponent()
@@ -32,7 +44,29 @@ void UHitbox::InitializeComponent()
 		return;
 	}
 
-	SetCollisionProfileName(HitboxProfile);
+	//Physics overlaps and the broadphase only know about the sphere, so it has to cover the whole shape.
+	//The sphere scales by the smallest axis while the shape scales per axis, so bound the scaled shape and undo the sphere's scale.
+	const float MinScale = GetComponentScale().GetAbsMin();
+	if (Shape != EHitboxShape::Circle && MinScale > UE_SMALL_NUMBER)
+	{
+		SetSphereRadius(GetShapeSettings().MakeShape2D(GetComponentScale().GetAbs(), 0.0f).GetBoundingRadius() / MinScale);
+	}
+
+	//Save off hitbox hostility for determining collision behavior with other hitboxes.
+	//Defaults to Neutral for actors not implementing the interface.
+	//This is needed here rather than in BeginPlay because it decides which collision profile the hitbox uses.
+	if (GetOwner()->Implements<UCombatInterface>())
+	{
+		OwnerHostility = ICombatInterface::Execute_GetHostility(GetOwner());
+	}
+	//When the hitbox manager's broadphase finds contacts, hitboxes don't need any physics collision.
+	const UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	if (IsValid(HitboxManager) && HitboxManager->IsUsingBroadphase())
+	{
+		SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		return;
+	}
+	ApplyHitboxProfile();
 	OnComponentBeginOverlap.AddDynamic(this, &UHitbox::OnOverlap);
 }
 
@@ -41,23 +75,30 @@ void UHitbox::BeginPlay()
 	Super::BeginPlay();
 	//Cache pawn owner to check for locally controlled when doing bounce collisions.
 	OwnerAsPawn = Cast<APawn>(GetOwner());
-	//Save off hitbox hostility for determining collision behavior with other hitboxes.
-	//Defaults to Neutral for actors not implementing the interface.
-	if (GetOwner()->Implements<UCombatInterface>())
-	{
-		OwnerHostility = ICombatInterface::Execute_GetHostility(GetOwner());
-	}
 	//Assign a unique ID to this hitbox, used for networking bounces and prioritizing hitboxes during collisions.
 	if (GetOwner()->HasAuthority())
 	{
 		UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
 		if (IsValid(HitboxManager))
 		{
+			//The archetype has to be registered first, since registering the hitbox reads it.
+			ArchetypeIndex = HitboxManager->RegisterArchetype(GetArchetypeData());
 			HitboxID = HitboxManager->RegisterNewHitbox(this);
 		}
 	}
 }
 
+void UHitbox::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//Release this hitbox's slot so it can be reused, and so that any moves still referencing this ID are rejected.
+	UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	if (IsValid(HitboxManager))
+	{
+		HitboxManager->UnregisterHitbox(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 void UHitbox::OnRep_HitboxID()
 {
 	if (HitboxID == -1)
@@ -67,20 +108,61 @@ void UHitbox::OnRep_HitboxID()
 	UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
 	if (IsValid(HitboxManager))
 	{
+		//The archetype index is replicated along with the ID, and only sent once, so it is always valid by the time the ID arrives.
+		HitboxManager->RegisterArchetype(GetArchetypeData(), ArchetypeIndex);
 		HitboxManager->RegisterNewHitbox(this, HitboxID);
 	}
 }
 
 void UHitbox::EnableHitbox()
 {
-	SetCollisionProfileName(HitboxProfile);
+	bHitboxEnabled = true;
+	//The broadphase picks this hitbox back up on its own once it is enabled.
+	const UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	if (IsValid(HitboxManager) && HitboxManager->IsUsingBroadphase())
+	{
+		return;
+	}
+	ApplyHitboxProfile();
 }
 
 void UHitbox::DisableHitbox()
 {
+	bHitboxEnabled = false;
 	SetCollisionEnabled(ECollisionEnabled::NoCollision);
 }
 
+void UHitbox::ApplyHitboxProfile()
+{
+	SetCollisionProfileName(GetHitboxProfile(OwnerHostility));
+	if (!CVarUseHostilityProfiles.GetValueOnGameThread())
+	{
+		//Every hostility's channel overlaps every other, the way a single hitbox channel did, so same-hostility pairs are reported and then thrown away.
+		for (const FName Profile : { NeutralHitboxProfile, EnemyHitboxProfile, AllyHitboxProfile })
+		{
+			ECollisionChannel Channel;
+			FCollisionResponseParams ResponseParams;
+			if (UCollisionProfile::GetChannelAndResponseParams(Profile, Channel, ResponseParams))
+			{
+				SetCollisionResponseToChannel(Channel, ECR_Overlap);
+			}
+		}
+	}
+}
+
+FName UHitbox::GetHitboxProfile(const EHostility Hostility)
+{
+	switch (Hostility)
+	{
+	case EHostility::Enemy:
+		return EnemyHitboxProfile;
+	case EHostility::Friendly:
+		return AllyHitboxProfile;
+	default:
+		return NeutralHitboxProfile;
+	}
+}
+
 bool UHitbox::IsOwnerLocallyControlled() const
 {
 	if (IsValid(OwnerAsPawn))
@@ -105,30 +187,16 @@ void UHitbox::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherA
 	{
 		return;
 	}
-	if (Cast<AMarioPlayerCharacter>(GetOwner()))
-	{
-		volatile int a = 0;
-	}
-	//When two hitboxes collide, only one of them actually processes the collision.
-	//The other will be notified by the one that does the processing.
-	//We also make sure that collisions involving predicting clients only happen on the predicting client machine.
-	//This assumes that we don't have collisions between two predicting clients (which we currently don't).
-	if (!ShouldProcessCollision(CollidingHitbox))
+	INC_DWORD_STAT(STAT_HitboxOverlapEvents);
+	//Both hitboxes get an overlap event for the same contact. The hitbox manager removes the duplicate and resolves the contact later in the frame.
+	UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	if (IsValid(HitboxManager))
 	{
-		return;
+		HitboxManager->QueueHitboxContact(this, CollidingHitbox);
 	}
-	//Calculate the bounce impulse and damage to apply to each hitbox.
-	FVector ImpulseToThis = FVector::ZeroVector;
-	FVector ImpulseToOther = FVector::ZeroVector;
-	float DamageToThis = 0.0f;
-	float DamageToOther = 0.0f;
-	ProcessCollision(CollidingHitbox, ImpulseToThis, ImpulseToOther, DamageToThis, DamageToOther);
-	//Broadcast the collision result, and tell the other hitbox to broadcast it as well.
-	OnHitboxCollision.Broadcast(CollidingHitbox, ImpulseToThis, DamageToThis, ImpulseToOther, DamageToOther);
-	CollidingHitbox->NotifyOfCollisionResult(this, ImpulseToOther, DamageToOther, ImpulseToThis, DamageToThis);
 }
 
-bool UHitbox::ShouldProcessCollision(UHitbox* OtherHitbox) const
+bool UHitbox::ShouldProcessCollision(const UHitbox* OtherHitbox) const
 {
 	//If two hitboxes are the same hostility, we won't process their collision.
 	//The hitbox whose hostility value is higher will be the one to process the collision.
@@ -158,37 +226,6 @@ bool UHitbox::ShouldProcessCollision(UHitbox* OtherHitbox) const
 	return false;
 }
 
-void UHitbox::ProcessCollision(UHitbox* OtherHitbox, FVector& ImpulseToThis, FVector& ImpulseToOther, float& DamageToThis, float& DamageToOther) const
-{
-	//Check if this hitbox is above the threshold to deal damage and receive a bounce from the other hitbox.
-	const float ThisHitboxMinZ = Bounds.Origin.Z - Bounds.BoxExtent.Z;
-	const float OtherHitboxThreshold = OtherHitbox->GetCollisionThreshold();
-
-	if (ThisHitboxMinZ > OtherHitboxThreshold)
-	{
-		if (DealsCollisionDamage() && OtherHitbox->CanBeCollisionDamaged())
-		{
-			DamageToOther = GetCollisionDamageDone();
-		}
-		if (CanBeBounced() && OtherHitbox->IsBouncy())
-		{
-			ImpulseToThis = OtherHitbox->GetBounceImpulse();
-		}
-	}
-	//If we were below the threshold, we will instead receive damage and potentially bounce the other hitbox.
-	else
-	{
-		if (CanBeCollisionDamaged() && OtherHitbox->DealsCollisionDamage())
-		{
-			DamageToThis = OtherHitbox->GetCollisionDamageDone();
-		}
-		if (IsBouncy() && OtherHitbox->CanBeBounced())
-		{
-			ImpulseToOther = GetBounceImpulse();
-		}
-	}
-}
-
 void UHitbox::NotifyOfCollisionResult(UHitbox* CollidingHitbox, const FVector& BounceToThis, const float DamageToThis,
 	const FVector& BounceToOther, const float DamageToOther)
 {
@@ -197,7 +234,63 @@ void UHitbox::NotifyOfCollisionResult(UHitbox* CollidingHitbox, const FVector& B
 
 float UHitbox::GetCollisionThreshold() const
 {
-	return FMath::Lerp(GetComponentLocation().Z - GetScaledSphereRadius(), GetComponentLocation().Z + GetScaledSphereRadius(), CollisionThreshold);
+	const FHitboxShape2D Shape2D = GetShape2D();
+	return HitboxCollision::GetThresholdHeight(GetComponentLocation().Z, Shape2D.GetVerticalHalfExtent(), GetArchetypeData().CollisionThreshold);
+}
+
+FHitboxShape2D UHitbox::GetShape2D() const
+{
+	return GetShapeSettings().MakeShape2D(GetComponentScale().GetAbs(), GetComponentQuat());
+}
+
+FHitboxShapeSettings UHitbox::GetShapeSettings() const
+{
+	FHitboxShapeSettings Settings;
+	Settings.Shape = Shape;
+	Settings.SphereRadius = GetUnscaledSphereRadius();
+	Settings.CapsuleRadius = CapsuleRadius;
+	Settings.CapsuleHalfHeight = CapsuleHalfHeight;
+	Settings.BoxHalfExtents = BoxHalfExtents;
+	return Settings;
+}
+
+float FHitboxShapeSettings::GetPlaneAngle(const FQuat& Rotation)
+{
+	const FVector Forward = Rotation.GetForwardVector();
+	return static_cast<float>(FMath::Atan2(Forward.Z, Forward.X));
+}
+
+FHitboxShape2D FHitboxShapeSettings::MakeShape2D(const FVector& Scale, const float Angle) const
+{
+	//Mirrored hitboxes have a negative scale, which only flips these symmetric shapes onto themselves.
+	const FVector AbsScale = Scale.GetAbs();
+	switch (Shape)
+	{
+	case EHitboxShape::Capsule:
+		return FHitboxShape2D::MakeCapsule(CapsuleRadius * FMath::Min(AbsScale.X, AbsScale.Z), CapsuleHalfHeight * AbsScale.Z, Angle);
+	case EHitboxShape::Box:
+		return FHitboxShape2D::MakeBox(BoxHalfExtents.X * AbsScale.X, BoxHalfExtents.Y * AbsScale.Z, Angle);
+	default:
+		//Circles scale the same way the sphere component does, by the smallest axis.
+		return FHitboxShape2D::MakeCircle(SphereRadius * Scale.GetAbsMin());
+	}
+}
+
+FHitboxArchetypeData UHitbox::GetArchetypeData() const
+{
+	if (IsValid(Archetype))
+	{
+		return Archetype->GetData();
+	}
+	FHitboxArchetypeData Data;
+	Data.CollisionThreshold = CollisionThreshold;
+	Data.bIsBouncy = bIsBouncy;
+	Data.BounceImpulse = BounceImpulse;
+	Data.bCanBeBounced = bCanBeBounced;
+	Data.bDealsCollisionDamage = bDealsCollisionDamage;
+	Data.CollisionDamage = CollisionDamage;
+	Data.bCanBeCollisionDamaged = bCanBeCollisionDamaged;
+	return Data;
 }
 
 void UHitbox::SubscribeToHitboxCollision(const FHitboxCallback& Callback)
@@ -0,0 +1,34 @@
+﻿#include "HitboxArchetype.h"
+
+EHitboxCapabilities FHitboxArchetypeData::GetCapabilities() const
+{
+	EHitboxCapabilities Capabilities = EHitboxCapabilities::None;
+	if (bIsBouncy)
+	{
+		Capabilities |= EHitboxCapabilities::Bouncy;
+	}
+	if (bCanBeBounced)
+	{
+		Capabilities |= EHitboxCapabilities::CanBeBounced;
+	}
+	if (bDealsCollisionDamage)
+	{
+		Capabilities |= EHitboxCapabilities::DealsDamage;
+	}
+	if (bCanBeCollisionDamaged)
+	{
+		Capabilities |= EHitboxCapabilities::CanBeDamaged;
+	}
+	return Capabilities;
+}
+
+bool FHitboxArchetypeData::operator==(const FHitboxArchetypeData& Other) const
+{
+	return CollisionThreshold == Other.CollisionThreshold
+		&& bIsBouncy == Other.bIsBouncy
+		&& BounceImpulse == Other.BounceImpulse
+		&& bCanBeBounced == Other.bCanBeBounced
+		&& bDealsCollisionDamage == Other.bDealsCollisionDamage
+		&& CollisionDamage == Other.CollisionDamage
+		&& bCanBeCollisionDamaged == Other.bCanBeCollisionDamaged;
+}
\ No newline at end of file
@@ -1,39 +1,801 @@
 ﻿#include "HitboxManager.h"
 #include "Hitbox.h"
+#include "Async/ParallelFor.h"
 #include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+
+DECLARE_CYCLE_STAT(TEXT("Record History"), STAT_HitboxRecordHistory, STATGROUP_Hitboxes);
+DECLARE_CYCLE_STAT(TEXT("Find Rewind Frame"), STAT_HitboxRewindQuery, STATGROUP_Hitboxes);
+DECLARE_CYCLE_STAT(TEXT("Validate Collisions"), STAT_HitboxValidateCollisions, STATGROUP_Hitboxes);
+DECLARE_CYCLE_STAT(TEXT("Rewind Positions"), STAT_HitboxRewindPositions, STATGROUP_Hitboxes);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Validated Collisions"), STAT_HitboxNumValidations, STATGROUP_Hitboxes);
+DECLARE_CYCLE_STAT(TEXT("Broadphase"), STAT_HitboxBroadphase, STATGROUP_Hitboxes);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Broadphase Pairs"), STAT_HitboxBroadphasePairs, STATGROUP_Hitboxes);
+DECLARE_CYCLE_STAT(TEXT("Resolve Contacts"), STAT_HitboxResolveContacts, STATGROUP_Hitboxes);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resolved Contacts"), STAT_HitboxNumContacts, STATGROUP_Hitboxes);
+DECLARE_MEMORY_STAT(TEXT("History Memory"), STAT_HitboxHistoryMemory, STATGROUP_Hitboxes);
+
+//The same paths are also timed for the CSV profiler, so that runs with -csvprofile can be compared between versions.
+CSV_DEFINE_CATEGORY(Hitboxes, true);
+
+//Memory allocated on each path is tagged for the low level memory tracker, so that runs with -llm can see which path allocates.
+//Rewinding for validation is counted under Rewind, since the innermost tag wins.
+LLM_DEFINE_TAG(HitboxRegister);
+LLM_DEFINE_TAG(HitboxBroadphase);
+LLM_DEFINE_TAG(HitboxRewind);
+LLM_DEFINE_TAG(HitboxValidate);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+static int64 GetTrackedBytes(const TCHAR* TagName)
+{
+	return FLowLevelMemTracker::Get().GetTagAmountForTracker(ELLMTracker::Default, FName(TagName), ELLMTagSet::None);
+}
+#endif
+
+static TAutoConsoleVariable<bool> CVarQuantizeHitboxHistory(
+	TEXT("Hitboxes.QuantizeHistory"),
+	true,
+	TEXT("Store lag compensation history as 2D fixed-point positions instead of full vectors. Takes effect the next time a world begins play."));
+
+static TAutoConsoleVariable<bool> CVarUseHitboxBroadphase(
+	TEXT("Hitboxes.UseBroadphase"),
+	true,
+	TEXT("Find hitbox contacts with the hitbox manager's sweep-and-prune broadphase instead of physics overlaps. Takes effect for worlds created afterwards."));
+
+static TAutoConsoleVariable<bool> CVarVectorizedHitboxRewind(
+	TEXT("Hitboxes.VectorizedRewind"),
+	true,
+	TEXT("Interpolate rewound hitbox positions four at a time with vector math instead of one at a time."));
+
+int32 FHitboxWorldHistory::Quantize(const double Value, const double Origin)
+{
+	const double Steps = (Value - Origin) / QuantizationStep;
+	ensureMsgf(FMath::Abs(Steps) <= MAX_int32, TEXT("Hitbox position %f is more than %f units from the origin and can't be quantized. It will be clamped."),
+		Value, MaxQuantizedDistance);
+	return static_cast<int32>(FMath::RoundToDouble(FMath::Clamp(Steps, static_cast<double>(-MAX_int32), static_cast<double>(MAX_int32))));
+}
+
+void FHitboxWorldHistory::Init(const int32 InMaxFrames, const bool bInQuantized, const FVector& InOrigin)
+{
+	MaxFrames = FMath::Max(InMaxFrames, 1);
+	NextFrame = 0;
+	Count = 0;
+	bQuantized = bInQuantized;
+	Origin = InOrigin;
+	FrameTimes.SetNumZeroed(MaxFrames);
+	FrameFirstEntries.SetNumZeroed(MaxFrames);
+	MaskWords = 0;
+	RecordedMasks.Empty();
+	MaskEntryOffsets.Empty();
+	FirstEntry = 0;
+	NextEntry = 0;
+	EntryCapacity = 0;
+	Positions.Empty();
+	QuantizedPositions.Empty();
+	SlotFirstFrames.Empty();
+	LastRecordedFrames.Empty();
+	LatestPositions.Empty();
+	BasePositions.Empty();
+	PlaneY.Empty();
+}
+
+template<typename T>
+void FHitboxWorldHistory::RelayoutMasks(TArray<T>& Masks, const int32 NewMaxFrames, const int32 NewMaskWords) const
+{
+	TArray<T> NewMasks;
+	NewMasks.SetNumZeroed(NewMaxFrames * NewMaskWords);
+	for (int64 Frame = GetOldestFrame(); Frame <= GetNewestFrame() && MaskWords > 0; Frame++)
+	{
+		FMemory::Memcpy(&NewMasks[static_cast<int32>(Frame % NewMaxFrames) * NewMaskWords], &Masks[GetRingIndex(Frame) * MaskWords], MaskWords * sizeof(T));
+	}
+	Masks = MoveTemp(NewMasks);
+}
+
+template<typename T>
+void FHitboxWorldHistory::RelayoutEntries(TArray<T>& Entries, const int32 NewCapacity) const
+{
+	TArray<T> NewEntries;
+	NewEntries.SetNumZeroed(NewCapacity);
+	for (int64 Entry = FirstEntry; Entry < NextEntry; Entry++)
+	{
+		NewEntries[static_cast<int32>(Entry % NewCapacity)] = Entries[GetEntryIndex(Entry)];
+	}
+	Entries = MoveTemp(NewEntries);
+}
+
+void FHitboxWorldHistory::EnsureSlotCapacity(const int32 NumSlots)
+{
+	if (NumSlots <= SlotFirstFrames.Num())
+	{
+		return;
+	}
+	//Grow geometrically so that registering hitboxes one at a time doesn't relayout the whole history each time.
+	const int32 NewNumSlots = FMath::Max3(NumSlots, SlotFirstFrames.Num() * 2, SlotsPerMaskWord);
+	const int32 NewMaskWords = FMath::DivideAndRoundUp(NewNumSlots, SlotsPerMaskWord);
+	if (NewMaskWords != MaskWords)
+	{
+		RelayoutMasks(RecordedMasks, MaxFrames, NewMaskWords);
+		RelayoutMasks(MaskEntryOffsets, MaxFrames, NewMaskWords);
+		MaskWords = NewMaskWords;
+	}
+	SlotFirstFrames.SetNumZeroed(NewNumSlots);
+	LastRecordedFrames.SetNumZeroed(NewNumSlots);
+	LatestPositions.SetNumZeroed(NewNumSlots);
+	BasePositions.SetNumZeroed(NewNumSlots);
+	PlaneY.SetNumZeroed(NewNumSlots);
+}
+
+void FHitboxWorldHistory::EnsureFrameCapacity(const int32 NewMaxFrames)
+{
+	if (NewMaxFrames <= MaxFrames)
+	{
+		return;
+	}
+	//Frame numbers map to different ring entries once the ring is resized, so every recorded frame moves. Entries stay where they are.
+	TArray<double> NewFrameTimes;
+	NewFrameTimes.SetNumZeroed(NewMaxFrames);
+	TArray<int64> NewFrameFirstEntries;
+	NewFrameFirstEntries.SetNumZeroed(NewMaxFrames);
+	for (int64 Frame = GetOldestFrame(); Frame <= GetNewestFrame(); Frame++)
+	{
+		NewFrameTimes[static_cast<int32>(Frame % NewMaxFrames)] = FrameTimes[GetRingIndex(Frame)];
+		NewFrameFirstEntries[static_cast<int32>(Frame % NewMaxFrames)] = FrameFirstEntries[GetRingIndex(Frame)];
+	}
+	RelayoutMasks(RecordedMasks, NewMaxFrames, MaskWords);
+	RelayoutMasks(MaskEntryOffsets, NewMaxFrames, MaskWords);
+	FrameTimes = MoveTemp(NewFrameTimes);
+	FrameFirstEntries = MoveTemp(NewFrameFirstEntries);
+	MaxFrames = NewMaxFrames;
+}
+
+void FHitboxWorldHistory::EnsureEntryCapacity(const int32 NumNeeded)
+{
+	if (NumNeeded <= EntryCapacity)
+	{
+		return;
+	}
+	const int32 NewCapacity = FMath::Max3(NumNeeded, EntryCapacity * 2, SlotsPerMaskWord);
+	if (bQuantized)
+	{
+		RelayoutEntries(QuantizedPositions, NewCapacity);
+	}
+	else
+	{
+		RelayoutEntries(Positions, NewCapacity);
+	}
+	EntryCapacity = NewCapacity;
+}
+
+int64 FHitboxWorldHistory::AddFrame(const double Timestamp)
+{
+	if (MaxFrames == 0)
+	{
+		return INDEX_NONE;
+	}
+	if (IsFull())
+	{
+		RemoveOldestFrame();
+	}
+	const int32 RingIndex = GetRingIndex(NextFrame);
+	FrameTimes[RingIndex] = Timestamp;
+	FrameFirstEntries[RingIndex] = NextEntry;
+	if (MaskWords > 0)
+	{
+		FMemory::Memzero(&RecordedMasks[RingIndex * MaskWords], MaskWords * sizeof(uint64));
+	}
+	Count++;
+	return NextFrame++;
+}
+
+void FHitboxWorldHistory::RemoveOldestFrame()
+{
+	const int64 Frame = GetOldestFrame();
+	const int32 RingIndex = GetRingIndex(Frame);
+	int64 Entry = FrameFirstEntries[RingIndex];
+	//Entries are packed in slot order, so walking the set bits in order visits the frame's entries in order.
+	for (int32 Word = 0; Word < MaskWords; Word++)
+	{
+		uint64 Mask = RecordedMasks[RingIndex * MaskWords + Word];
+		while (Mask != 0)
+		{
+			const int32 Slot = Word * SlotsPerMaskWord + static_cast<int32>(FMath::CountTrailingZeros64(Mask));
+			//Entries recorded by a slot's previous occupant say nothing about where the current one was.
+			if (Frame >= SlotFirstFrames[Slot])
+			{
+				BasePositions[Slot] = GetEntryPosition(Entry, Slot);
+			}
+			Entry++;
+			Mask &= Mask - 1;
+		}
+	}
+	FirstEntry = Entry;
+	Count--;
+}
+
+void FHitboxWorldHistory::ResetSlot(const int32 Slot, const int64 FirstFrame, const FVector& Position)
+{
+	SlotFirstFrames[Slot] = FirstFrame;
+	LastRecordedFrames[Slot] = FirstFrame - 1;
+	LatestPositions[Slot] = Position;
+	BasePositions[Slot] = Position;
+	PlaneY[Slot] = Position.Y;
+}
+
+void FHitboxWorldHistory::RecordPosition(const int32 Slot, const FVector& Position)
+{
+	const int64 Frame = GetNewestFrame();
+	const int32 RingIndex = GetRingIndex(Frame);
+	const int32 MaskIndex = RingIndex * MaskWords + Slot / SlotsPerMaskWord;
+	const uint64 Bit = 1ull << (Slot % SlotsPerMaskWord);
+	uint64& Mask = RecordedMasks[MaskIndex];
+	checkSlow(Mask < Bit);
+	//A word's offset is however many entries the frame had recorded before the first slot in the word.
+	if (Mask == 0)
+	{
+		MaskEntryOffsets[MaskIndex] = static_cast<uint32>(NextEntry - FrameFirstEntries[RingIndex]);
+	}
+	Mask |= Bit;
+	EnsureEntryCapacity(NumEntries() + 1);
+	SetEntryPosition(NextEntry++, Slot, Position);
+	LastRecordedFrames[Slot] = Frame;
+	LatestPositions[Slot] = Position;
+}
+
+int64 FHitboxWorldHistory::FindEntry(const int64 Frame, const int32 Slot) const
+{
+	const int32 RingIndex = GetRingIndex(Frame);
+	const int32 MaskIndex = RingIndex * MaskWords + Slot / SlotsPerMaskWord;
+	const uint64 Bit = 1ull << (Slot % SlotsPerMaskWord);
+	const uint64 Mask = RecordedMasks[MaskIndex];
+	if ((Mask & Bit) == 0)
+	{
+		return INDEX_NONE;
+	}
+	return FrameFirstEntries[RingIndex] + MaskEntryOffsets[MaskIndex] + FMath::CountBits(Mask & (Bit - 1));
+}
+
+FVector FHitboxWorldHistory::GetEntryPosition(const int64 Entry, const int32 Slot) const
+{
+	const int32 Index = GetEntryIndex(Entry);
+	if (!bQuantized)
+	{
+		return Positions[Index];
+	}
+	const FIntPoint& Quantized = QuantizedPositions[Index];
+	return FVector(Dequantize(Quantized.X, Origin.X), PlaneY[Slot], Dequantize(Quantized.Y, Origin.Z));
+}
+
+void FHitboxWorldHistory::SetEntryPosition(const int64 Entry, const int32 Slot, const FVector& Position)
+{
+	const int32 Index = GetEntryIndex(Entry);
+	if (!bQuantized)
+	{
+		Positions[Index] = Position;
+		return;
+	}
+	QuantizedPositions[Index] = FIntPoint(Quantize(Position.X, Origin.X), Quantize(Position.Z, Origin.Z));
+	PlaneY[Slot] = Position.Y;
+}
+
+FVector FHitboxWorldHistory::GetPosition(const int64 Frame, const int32 Slot) const
+{
+	const int64 FirstFrame = SlotFirstFrames[Slot];
+	const int64 ClampedFrame = FMath::Max(Frame, FirstFrame);
+	//Frames after the last one that recorded this slot weren't recorded because the hitbox was still or disabled.
+	if (ClampedFrame >= LastRecordedFrames[Slot])
+	{
+		return LatestPositions[Slot];
+	}
+	//Otherwise search back for the newest frame that recorded the slot. Moving hitboxes are recorded every frame, so this usually stops straight away.
+	for (int64 Searched = FMath::Min(ClampedFrame, GetNewestFrame()); Searched >= FMath::Max(FirstFrame, GetOldestFrame()); Searched--)
+	{
+		const int64 Entry = FindEntry(Searched, Slot);
+		if (Entry != INDEX_NONE)
+		{
+			return GetEntryPosition(Entry, Slot);
+		}
+	}
+	return BasePositions[Slot];
+}
+
+SIZE_T FHitboxWorldHistory::GetAllocatedSize() const
+{
+	return FrameTimes.GetAllocatedSize() + FrameFirstEntries.GetAllocatedSize() + RecordedMasks.GetAllocatedSize() + MaskEntryOffsets.GetAllocatedSize()
+		+ Positions.GetAllocatedSize() + QuantizedPositions.GetAllocatedSize() + SlotFirstFrames.GetAllocatedSize() + LastRecordedFrames.GetAllocatedSize()
+		+ LatestPositions.GetAllocatedSize() + BasePositions.GetAllocatedSize() + PlaneY.GetAllocatedSize();
+}
+
+FHitboxRewindFrame FHitboxWorldHistory::FindRewindFrame(const double Timestamp, const double CurrentTime) const
+{
+	return HitboxCollision::FindRewindFrame(FrameTimes, GetOldestFrame(), Count, Timestamp, CurrentTime);
+}
+
+void FHitboxStateMirror::SetNum(const int32 NewNum)
+{
+	Positions.SetNum(NewNum);
+	Rotations.SetNum(NewNum);
+	Scales.SetNum(NewNum);
+	ShapeSettings.SetNum(NewNum);
+	Radii.SetNum(NewNum);
+	Shapes.SetNum(NewNum);
+	ArchetypeIndices.SetNum(NewNum);
+	Hostilities.SetNum(NewNum);
+	Flags.SetNum(NewNum);
+}
+
+void FHitboxStateMirror::Refresh(const int32 Index, const UHitbox* Hitbox)
+{
+	Gather(Index, Hitbox);
+	UpdateShape(Index);
+}
+
+void FHitboxStateMirror::Gather(const int32 Index, const UHitbox* Hitbox)
+{
+	if (!IsValid(Hitbox))
+	{
+		Clear(Index);
+		return;
+	}
+	const FTransform& Transform = Hitbox->GetComponentTransform();
+	Positions[Index] = Transform.GetLocation();
+	Rotations[Index] = Transform.GetRotation();
+	Scales[Index] = Transform.GetScale3D();
+	ShapeSettings[Index] = Hitbox->GetShapeSettings();
+	ArchetypeIndices[Index] = Hitbox->GetArchetypeIndex();
+	Hostilities[Index] = Hitbox->GetHostility();
+	EHitboxStateFlags NewFlags = EHitboxStateFlags::Registered;
+	if (Hitbox->IsHitboxEnabled())
+	{
+		NewFlags |= EHitboxStateFlags::Enabled;
+	}
+	Flags[Index] = NewFlags;
+}
+
+void FHitboxStateMirror::UpdateShape(const int32 Index)
+{
+	if (!HasFlags(Index, EHitboxStateFlags::Registered))
+	{
+		return;
+	}
+	Shapes[Index] = ShapeSettings[Index].MakeShape2D(Scales[Index], Rotations[Index]);
+	Radii[Index] = Shapes[Index].GetBoundingRadius();
+}
+
+SIZE_T FHitboxStateMirror::GetAllocatedSize() const
+{
+	return Positions.GetAllocatedSize() + Rotations.GetAllocatedSize() + Scales.GetAllocatedSize() + ShapeSettings.GetAllocatedSize()
+		+ Radii.GetAllocatedSize() + Shapes.GetAllocatedSize() + ArchetypeIndices.GetAllocatedSize() + Hostilities.GetAllocatedSize() + Flags.GetAllocatedSize();
+}
+
+void FHitboxStateMirror::Clear(const int32 Index)
+{
+	Flags[Index] = EHitboxStateFlags::None;
+}
+
+void UHitboxManager::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	//This has to be decided before any hitboxes initialize, since it determines how they set up their collision.
+	bUseBroadphase = CVarUseHitboxBroadphase.GetValueOnGameThread();
+}
 
 void UHitboxManager::OnWorldBeginPlay(UWorld& InWorld)
 {
 	Super::OnWorldBeginPlay(InWorld);
-	HitboxMap.Empty();
+	HitboxSlots.Empty();
+	FreeSlots.Empty();
+	Archetypes.Empty();
+	ArchetypeCapabilities.Empty();
+	ArchetypesRegistered.Empty();
+	StateMirror.SetNum(0);
+	PendingValidations.Empty();
+	BroadphaseEntries.Empty();
+	OverlappingPairs.Empty();
+	PendingContacts.Empty();
+	//Quantized positions are stored relative to the world origin, which keeps them near zero even if the origin has been rebased.
+	History.Init(MinHistoryFrames, CVarQuantizeHitboxHistory.GetValueOnGameThread(), FVector(InWorld.OriginLocation));
 }
 
 void UHitboxManager::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	//No need to tick on clients.
-	if (GetWorld()->IsNetMode(NM_Client))
 	{
+		CSV_SCOPED_TIMING_STAT(Hitboxes, Tick);
+		FSimpleScopeSecondsCounter TickTimer(FrameTimings.Tick);
+		TickManager(DeltaTime);
+	}
+	FrameTimings.NumHitboxes = HitboxSlots.Num() - FreeSlots.Num();
+	FrameTimings.AllocatedBytes = GetAllocatedSize();
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if (FLowLevelMemTracker::IsEnabled())
+	{
+		FrameTimings.RegisterTrackedBytes = GetTrackedBytes(TEXT("HitboxRegister"));
+		FrameTimings.BroadphaseTrackedBytes = GetTrackedBytes(TEXT("HitboxBroadphase"));
+		FrameTimings.RewindTrackedBytes = GetTrackedBytes(TEXT("HitboxRewind"));
+		FrameTimings.ValidateTrackedBytes = GetTrackedBytes(TEXT("HitboxValidate"));
+	}
+#endif
+	CSV_CUSTOM_STAT(Hitboxes, NumHitboxes, FrameTimings.NumHitboxes, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Hitboxes, NumContacts, FrameTimings.NumContacts, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Hitboxes, NumValidations, FrameTimings.NumValidations, ECsvCustomStatOp::Set);
+	LastFrameTimings = FrameTimings;
+	FrameTimings = FHitboxFrameTimings();
+}
+
+SIZE_T UHitboxManager::GetAllocatedSize() const
+{
+	return HitboxSlots.GetAllocatedSize() + FreeSlots.GetAllocatedSize() + History.GetAllocatedSize() + StateMirror.GetAllocatedSize()
+		+ BroadphaseEntries.GetAllocatedSize() + OverlappingPairs.GetAllocatedSize() + PendingContacts.GetAllocatedSize()
+		+ Contacts.GetAllocatedSize() + ContactResults.GetAllocatedSize() + PendingValidations.GetAllocatedSize() + SlotsToRecord.GetAllocatedSize();
+}
+
+void UHitboxManager::TickManager(const float DeltaTime)
+{
+	//Contacts are needed everywhere, since predicting clients process their own collisions.
+	if (bUseBroadphase)
+	{
+		UpdateBroadphase();
+	}
+	//Physics overlaps all happen while actors tick, so by now every contact for this frame has been queued.
+	ContactFrameDeltaTime = DeltaTime;
+	ResolvePendingContacts();
+	//Clients don't record history or validate collisions, and there's nothing to record until the game has started, since history timestamps come from the game state.
+	//The mirror is still kept up to date everywhere, since it is where next frame's physics overlaps are swept from.
+	if (GetWorld()->IsNetMode(NM_Client) || !IsValid(GetWorld()->GetGameState()))
+	{
+		RefreshStateMirror(INDEX_NONE);
 		return;
 	}
 
-	for (const TTuple<int32, UHitbox*> HitboxTuple : HitboxMap)
+	const double Timestamp = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
+	//If the history is full but doesn't reach back over the whole window, the server is running faster than the history was sized for.
+	if (History.IsFull() && History.GetMaxFrames() < MaxHistoryFrames
+		&& (Timestamp - History.GetFrameTime(History.GetOldestFrame())) * 1000.0 < HistoryWindowMs)
+	{
+		History.EnsureFrameCapacity(FMath::Min(History.GetMaxFrames() * 2, static_cast<int32>(MaxHistoryFrames)));
+	}
+	History.EnsureSlotCapacity(HitboxSlots.Num());
+	SET_MEMORY_STAT(STAT_HitboxHistoryMemory, History.GetAllocatedSize());
+	const int64 Frame = History.AddFrame(Timestamp);
+	
+	{
+		SCOPE_CYCLE_COUNTER(STAT_HitboxRecordHistory);
+		RefreshStateMirror(Frame);
+		//Frames pack their entries in slot order, so the slots that moved are written one after another.
+		for (int32 Index = 0; Index < HitboxSlots.Num(); Index++)
+		{
+			if (SlotsToRecord[Index])
+			{
+				History.RecordPosition(Index, StateMirror.Positions[Index]);
+			}
+		}
+	}
+
+	//Moves are received before the world ticks, so every collision clients reported this frame is already queued.
+	ValidatePendingCollisions(Timestamp);
+}
+
+void UHitboxManager::RefreshStateMirror(const int64 Frame)
+{
+	//Components and their owners are only ever read on the game thread, so their state is copied out first.
+	for (int32 Index = 0; Index < HitboxSlots.Num(); Index++)
+	{
+		StateMirror.Gather(Index, HitboxSlots[Index].Hitbox);
+	}
+	//Everything after gathering is math on the copies. Each slot only touches its own mirror entries, so slots can be processed independently.
+	SlotsToRecord.SetNumUninitialized(HitboxSlots.Num(), false);
+	ParallelFor(HitboxSlots.Num(), [this, Frame](const int32 Index)
+	{
+		StateMirror.UpdateShape(Index);
+		SlotsToRecord[Index] = Frame != INDEX_NONE && ShouldRecordSlot(Index);
+	});
+}
+
+bool UHitboxManager::GetMirroredStartLocation(const UHitbox* Hitbox, FVector& OutLocation) const
+{
+	const int32 HitboxID = Hitbox->GetHitboxID();
+	if (!FindSlot(HitboxID))
+	{
+		return false;
+	}
+	OutLocation = StateMirror.Positions[GetHitboxIndex(HitboxID)];
+	//Teleports are treated like the broadphase treats them, as not having moved through anything on the way.
+	if (FVector::DistSquared(OutLocation, Hitbox->GetComponentLocation()) > FMath::Square(MaxSweepDistance))
+	{
+		OutLocation = Hitbox->GetComponentLocation();
+	}
+	return true;
+}
+
+void UHitboxManager::UpdateBroadphase()
+{
+	SCOPE_CYCLE_COUNTER(STAT_HitboxBroadphase);
+	CSV_SCOPED_TIMING_STAT(Hitboxes, Broadphase);
+	FSimpleScopeSecondsCounter BroadphaseTimer(FrameTimings.Broadphase);
+	LLM_SCOPE_BYTAG(HitboxBroadphase);
+	//Drop entries for hitboxes that have unregistered or been disabled, and refresh the rest.
+	for (int32 Entry = BroadphaseEntries.Num() - 1; Entry >= 0; Entry--)
+	{
+		FHitboxBroadphaseEntry& BroadphaseEntry = BroadphaseEntries[Entry];
+		const UHitbox* Hitbox = FindHitbox(BroadphaseEntry.HitboxID);
+		if (!IsValid(Hitbox) || !Hitbox->IsHitboxEnabled())
+		{
+			const int32 Index = GetHitboxIndex(BroadphaseEntry.HitboxID);
+			if (HitboxSlots.IsValidIndex(Index))
+			{
+				HitboxSlots[Index].bInBroadphase = false;
+			}
+			BroadphaseEntries.RemoveAt(Entry, 1, false);
+			continue;
+		}
+		BroadphaseEntry.PreviousLocation = BroadphaseEntry.Location;
+		BroadphaseEntry.Location = Hitbox->GetComponentLocation();
+		//Respawning and other teleports shouldn't collide with everything between the old and new locations.
+		if (FVector::DistSquared(BroadphaseEntry.PreviousLocation, BroadphaseEntry.Location) > FMath::Square(MaxSweepDistance))
+		{
+			BroadphaseEntry.PreviousLocation = BroadphaseEntry.Location;
+		}
+		BroadphaseEntry.Shape = Hitbox->GetShape2D();
+		BroadphaseEntry.Radius = BroadphaseEntry.Shape.GetBoundingRadius();
+		BroadphaseEntry.MinX = FMath::Min(BroadphaseEntry.PreviousLocation.X, BroadphaseEntry.Location.X) - BroadphaseEntry.Radius;
+		BroadphaseEntry.MaxX = FMath::Max(BroadphaseEntry.PreviousLocation.X, BroadphaseEntry.Location.X) + BroadphaseEntry.Radius;
+	}
+	//Add entries for hitboxes that have registered or been enabled since last frame.
+	for (int32 Index = 0; Index < HitboxSlots.Num(); Index++)
+	{
+		FHitboxSlot& Slot = HitboxSlots[Index];
+		if (Slot.bInBroadphase || !IsValid(Slot.Hitbox) || !Slot.Hitbox->IsHitboxEnabled())
+		{
+			continue;
+		}
+		Slot.bInBroadphase = true;
+		FHitboxBroadphaseEntry& BroadphaseEntry = BroadphaseEntries.AddDefaulted_GetRef();
+		BroadphaseEntry.HitboxID = Slot.Hitbox->GetHitboxID();
+		BroadphaseEntry.Hostility = Slot.Hitbox->GetHostility();
+		BroadphaseEntry.Location = Slot.Hitbox->GetComponentLocation();
+		BroadphaseEntry.PreviousLocation = BroadphaseEntry.Location;
+		BroadphaseEntry.Shape = Slot.Hitbox->GetShape2D();
+		BroadphaseEntry.Radius = BroadphaseEntry.Shape.GetBoundingRadius();
+		BroadphaseEntry.MinX = BroadphaseEntry.Location.X - BroadphaseEntry.Radius;
+		BroadphaseEntry.MaxX = BroadphaseEntry.Location.X + BroadphaseEntry.Radius;
+	}
+	//Insertion sort, since the entries are almost always in order already and this is close to linear in that case.
+	for (int32 Entry = 1; Entry < BroadphaseEntries.Num(); Entry++)
+	{
+		FHitboxBroadphaseEntry Moving = BroadphaseEntries[Entry];
+		int32 Insert = Entry;
+		while (Insert > 0 && BroadphaseEntries[Insert - 1].MinX > Moving.MinX)
+		{
+			BroadphaseEntries[Insert] = BroadphaseEntries[Insert - 1];
+			Insert--;
+		}
+		BroadphaseEntries[Insert] = Moving;
+	}
+	//Sweep along X. Each entry only needs to be tested against the entries that start before it ends.
+	//Movement is constrained to the X/Z plane, so hitboxes are tested as circles in that plane, swept along their paths since last frame.
+	TSet<uint64> CurrentPairs;
+	CurrentPairs.Reserve(OverlappingPairs.Num());
+	for (int32 Entry = 0; Entry < BroadphaseEntries.Num(); Entry++)
 	{
-		const UHitbox* Hitbox = HitboxTuple.Value;
-		if (IsValid(Hitbox))
+		const FHitboxBroadphaseEntry& First = BroadphaseEntries[Entry];
+		for (int32 Other = Entry + 1; Other < BroadphaseEntries.Num() && BroadphaseEntries[Other].MinX <= First.MaxX; Other++)
 		{
-			if (FHitboxSnapshotArray* SnapshotArray = HitboxSnapshots.Find(HitboxTuple.Key))
+			const FHitboxBroadphaseEntry& Second = BroadphaseEntries[Other];
+			if (First.Hostility == Second.Hostility)
+			{
+				continue;
+			}
+			float TimeOfImpact;
+			if (!HitboxCollision::SweepCircles(First.PreviousLocation, First.Location, Second.PreviousLocation, Second.Location, First.Radius + Second.Radius, TimeOfImpact))
 			{
-				SnapshotArray->Snapshots.Add(FHitboxSnapshot(GetWorld()->GetGameState()->GetServerWorldTimeSeconds(), Hitbox->GetComponentLocation()));
-				//Remove the oldest snapshots if we have more than our buffer.
-				while (SnapshotArray->Snapshots.Num() > MaxSnapshots)
+				continue;
+			}
+			//Hitboxes that aren't circles were only swept as their bounding circles.
+			//Their actual shapes are tested where the bounding circles met and where the hitboxes ended up, and the pair only counts as touching if either hits.
+			//If only the end hits, the shapes met somewhere in between, which is found by bisecting the rest of the frame.
+			if (!First.Shape.IsCircle() || !Second.Shape.IsCircle())
+			{
+				const FVector FirstAtImpact = FMath::Lerp(First.PreviousLocation, First.Location, static_cast<double>(TimeOfImpact));
+				const FVector SecondAtImpact = FMath::Lerp(Second.PreviousLocation, Second.Location, static_cast<double>(TimeOfImpact));
+				if (!HitboxCollision::AreShapesTouching(FirstAtImpact, First.Shape, SecondAtImpact, Second.Shape))
 				{
-					SnapshotArray->Snapshots.RemoveAt(0);
+					if (!HitboxCollision::AreShapesTouching(First.Location, First.Shape, Second.Location, Second.Shape))
+					{
+						continue;
+					}
+					TimeOfImpact = HitboxCollision::FindTimeOfImpact(First.PreviousLocation, First.Location, First.Shape,
+						Second.PreviousLocation, Second.Location, Second.Shape, TimeOfImpact);
 				}
 			}
+			const uint64 PairKey = MakePairKey(First.HitboxID, Second.HitboxID);
+			CurrentPairs.Add(PairKey);
+			if (OverlappingPairs.Contains(PairKey))
+			{
+				continue;
+			}
+			//Resolve the contact where the hitboxes actually met, rather than where they ended up.
+			const bool bFirstIsLower = First.HitboxID < Second.HitboxID;
+			const FHitboxBroadphaseEntry& Lower = bFirstIsLower ? First : Second;
+			const FHitboxBroadphaseEntry& Higher = bFirstIsLower ? Second : First;
+			FHitboxPendingContact& Contact = PendingContacts.AddDefaulted_GetRef();
+			Contact.PairKey = PairKey;
+			Contact.First = HitboxSlots[GetHitboxIndex(Lower.HitboxID)].Hitbox;
+			Contact.Second = HitboxSlots[GetHitboxIndex(Higher.HitboxID)].Hitbox;
+			Contact.TimeOfImpact = TimeOfImpact;
+			Contact.bHasImpactLocations = true;
+			Contact.FirstLocation = FMath::Lerp(Lower.PreviousLocation, Lower.Location, static_cast<double>(TimeOfImpact));
+			Contact.SecondLocation = FMath::Lerp(Higher.PreviousLocation, Higher.Location, static_cast<double>(TimeOfImpact));
+		}
+	}
+	OverlappingPairs = MoveTemp(CurrentPairs);
+	SET_DWORD_STAT(STAT_HitboxBroadphasePairs, OverlappingPairs.Num());
+}
+
+void UHitboxManager::QueueHitboxContact(UHitbox* First, UHitbox* Second)
+{
+	if (!IsValid(First) || !IsValid(Second))
+	{
+		return;
+	}
+	FrameTimings.NumOverlapEvents++;
+	const int32 FirstID = First->GetHitboxID();
+	const int32 SecondID = Second->GetHitboxID();
+	FHitboxPendingContact& Contact = PendingContacts.AddDefaulted_GetRef();
+	if (FirstID == -1 || SecondID == -1)
+	{
+		//Without both IDs, the two reports of this contact are matched up by their hitboxes instead.
+		Contact.PairKey = UnregisteredPairKey;
+		Contact.First = First < Second ? First : Second;
+		Contact.Second = First < Second ? Second : First;
+		return;
+	}
+	Contact.PairKey = MakePairKey(FirstID, SecondID);
+	Contact.First = FirstID < SecondID ? First : Second;
+	Contact.Second = FirstID < SecondID ? Second : First;
+}
+
+void UHitboxManager::ResolvePendingContacts()
+{
+	if (PendingContacts.Num() == 0)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_HitboxResolveContacts);
+	CSV_SCOPED_TIMING_STAT(Hitboxes, ResolveContacts);
+	FSimpleScopeSecondsCounter ResolveTimer(FrameTimings.ResolveContacts);
+	//Pair keys put the lower ID in the high bits, so sorting them orders contacts by (min ID, max ID) and puts duplicates next to each other.
+	//Among duplicates, the earliest time of impact comes first and is the one that is kept.
+	PendingContacts.Sort([](const FHitboxPendingContact& A, const FHitboxPendingContact& B)
+	{
+		return A.PairKey != B.PairKey ? A.PairKey < B.PairKey : A.TimeOfImpact < B.TimeOfImpact;
+	});
+	//Gathering runs on the game thread, since it reads hitbox components and their owners.
+	Contacts.Reset();
+	for (int32 Contact = 0; Contact < PendingContacts.Num(); Contact++)
+	{
+		const FHitboxPendingContact& Pending = PendingContacts[Contact];
+		const uint64 PairKey = Pending.PairKey;
+		if (PairKey != UnregisteredPairKey && Contact > 0 && PendingContacts[Contact - 1].PairKey == PairKey)
+		{
+			continue;
+		}
+		//Contacts without IDs all share a key at the end of the list. There are only ever a few of them, in the frames before IDs replicate,
+		//so duplicates are found by comparing hitboxes with the ones before them.
+		if (PairKey == UnregisteredPairKey && IsDuplicateUnregisteredContact(Contact))
+		{
+			continue;
+		}
+		UHitbox* FirstHitbox = Pending.First.Get();
+		UHitbox* SecondHitbox = Pending.Second.Get();
+		if (!IsValid(FirstHitbox) || !IsValid(SecondHitbox) || !FirstHitbox->IsHitboxEnabled() || !SecondHitbox->IsHitboxEnabled())
+		{
+			continue;
+		}
+		//Only one of the two hitboxes actually processes the collision. The other will be sent the result.
+		//We also make sure that collisions involving predicting clients only happen on the predicting client machine.
+		//This assumes that we don't have collisions between two predicting clients (which we currently don't).
+		UHitbox* Processor = FirstHitbox->ShouldProcessCollision(SecondHitbox) ? FirstHitbox
+			: SecondHitbox->ShouldProcessCollision(FirstHitbox) ? SecondHitbox : nullptr;
+		if (!Processor)
+		{
+			continue;
+		}
+		UHitbox* Other = Processor == FirstHitbox ? SecondHitbox : FirstHitbox;
+		FHitboxContact& NewContact = Contacts.AddDefaulted_GetRef();
+		NewContact.Processor = Processor;
+		NewContact.Other = Other;
+		NewContact.ProcessorParams = GetHitboxCollisionParams(Processor);
+		NewContact.OtherParams = GetHitboxCollisionParams(Other);
+		NewContact.TimeOfImpact = Pending.TimeOfImpact;
+		if (Pending.bHasImpactLocations)
+		{
+			const bool bProcessorIsFirst = Processor == FirstHitbox;
+			NewContact.ProcessorParams.Location = bProcessorIsFirst ? Pending.FirstLocation : Pending.SecondLocation;
+			NewContact.OtherParams.Location = bProcessorIsFirst ? Pending.SecondLocation : Pending.FirstLocation;
+			NewContact.bNeedsOverlapTest = false;
+		}
+		else
+		{
+			NewContact.bHasStartLocations = GetMirroredStartLocation(Processor, NewContact.ProcessorStart) && GetMirroredStartLocation(Other, NewContact.OtherStart);
+		}
+	}
+	PendingContacts.Reset();
+	//The narrowphase only reads the gathered params, so contacts can be resolved on any thread.
+	ParallelFor(Contacts.Num(), [this](const int32 Contact)
+	{
+		const FHitboxContact& ToResolve = Contacts[Contact];
+		const FHitboxCollisionParams& ProcessorParams = ToResolve.ProcessorParams;
+		const FHitboxCollisionParams& OtherParams = ToResolve.OtherParams;
+		//Exact shape test in the X/Z plane. Physics overlaps are reported mid-move, so the hitboxes may have separated since.
+		if (ToResolve.bNeedsOverlapTest && !HitboxCollision::AreShapesTouching(ProcessorParams.Location, ProcessorParams.Shape, OtherParams.Location, OtherParams.Shape))
+		{
+			return;
+		}
+		FHitboxContactResult ContactResult;
+		ContactResult.Contact = Contact;
+		ContactResult.TimeOfImpact = ToResolve.bHasStartLocations
+			? HitboxCollision::FindTimeOfImpact(ToResolve.ProcessorStart, ProcessorParams.Location, ProcessorParams.Shape,
+				ToResolve.OtherStart, OtherParams.Location, OtherParams.Shape)
+			: ToResolve.TimeOfImpact;
+		HitboxCollision::ProcessCollision(ProcessorParams, OtherParams, ContactResult.Result);
+		ContactResultQueue.Enqueue(ContactResult);
+	});
+	//Results arrive in whatever order the workers finished, so sort them back into contact order, which is pair order, to keep dispatch deterministic.
+	ContactResults.Reset();
+	FHitboxContactResult DrainedResult;
+	while (ContactResultQueue.Dequeue(DrainedResult))
+	{
+		ContactResults.Add(DrainedResult);
+	}
+	ContactResults.Sort([](const FHitboxContactResult& A, const FHitboxContactResult& B) { return A.Contact < B.Contact; });
+	SET_DWORD_STAT(STAT_HitboxNumContacts, ContactResults.Num());
+	FrameTimings.NumContacts = ContactResults.Num();
+	//Every contact is resolved against the same state before any results go out, since results can bounce, damage, or kill hitboxes.
+	//Hitboxes are looked up again for each result in case an earlier one destroyed them.
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const double FrameEndTime = IsValid(GameState) ? GameState->GetServerWorldTimeSeconds() : -1.0;
+	for (const FHitboxContactResult& ContactResult : ContactResults)
+	{
+		UHitbox* Processor = Contacts[ContactResult.Contact].Processor.Get();
+		UHitbox* Other = Contacts[ContactResult.Contact].Other.Get();
+		if (!IsValid(Processor) || !IsValid(Other))
+		{
+			continue;
+		}
+		DispatchingContactTime = FrameEndTime < 0.0 ? -1.0 : FrameEndTime - (1.0 - ContactResult.TimeOfImpact) * ContactFrameDeltaTime;
+		const FHitboxCollisionResult& Result = ContactResult.Result;
+		Processor->NotifyOfCollisionResult(Other, Result.ImpulseToThis, Result.DamageToThis, Result.ImpulseToOther, Result.DamageToOther);
+		Other->NotifyOfCollisionResult(Processor, Result.ImpulseToOther, Result.DamageToOther, Result.ImpulseToThis, Result.DamageToThis);
+	}
+	DispatchingContactTime = -1.0;
+}
+
+bool UHitboxManager::IsDuplicateUnregisteredContact(const int32 Contact) const
+{
+	const FHitboxPendingContact& Pending = PendingContacts[Contact];
+	for (int32 Earlier = Contact - 1; Earlier >= 0 && PendingContacts[Earlier].PairKey == UnregisteredPairKey; Earlier--)
+	{
+		if (PendingContacts[Earlier].First == Pending.First && PendingContacts[Earlier].Second == Pending.Second)
+		{
+			return true;
 		}
 	}
+	return false;
+}
+
+bool UHitboxManager::ShouldRecordSlot(const int32 Index) const
+{
+	//Disabled hitboxes stop recording and hold their last position.
+	if (!StateMirror.HasFlags(Index, EHitboxStateFlags::Registered | EHitboxStateFlags::Enabled))
+	{
+		return false;
+	}
+	//Hitboxes that haven't moved just keep holding their last position.
+	return FVector::DistSquared(StateMirror.Positions[Index], History.GetLatestPosition(Index)) > FMath::Square(HistoryMotionEpsilon);
 }
 
 int32 UHitboxManager::RegisterNewHitbox(UHitbox* Hitbox)
@@ -42,13 +804,33 @@ int32 UHitboxManager::RegisterNewHitbox(UHitbox* Hitbox)
 	{
 		return -1;
 	}
-	const int32 NewID = HitboxIDCounter++;
-	HitboxMap.Add(NewID, Hitbox);
-	//Create a snapshot array for this hitbox so the server can validate client collisions.
-	FHitboxSnapshotArray& SnapshotArray = HitboxSnapshots.Add(NewID);
-	//Add an initial snapshot.
-	SnapshotArray.Snapshots.Add(FHitboxSnapshot(GetWorld()->GetGameState()->GetServerWorldTimeSeconds(), Hitbox->GetComponentLocation()));
-	return NewID;
+	CSV_SCOPED_TIMING_STAT(Hitboxes, Register);
+	FSimpleScopeSecondsCounter RegisterTimer(FrameTimings.Register);
+	LLM_SCOPE_BYTAG(HitboxRegister);
+	//Reuse a released slot if there is one, so the slot array only grows to the peak number of live hitboxes.
+	int32 Index;
+	if (FreeSlots.Num() > 0)
+	{
+		Index = FreeSlots.Pop(false);
+	}
+	else
+	{
+		if (HitboxSlots.Num() > HitboxIndexMask)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Ran out of hitbox slots, %s will not be registered."), *Hitbox->GetName());
+			return -1;
+		}
+		Index = AddSlot();
+	}
+	FHitboxSlot& Slot = HitboxSlots[Index];
+	Slot.Hitbox = Hitbox;
+	//Fill in the mirror right away, since the next refresh won't happen until the end of the frame.
+	StateMirror.Refresh(Index, Hitbox);
+	//History recorded in this slot before now belongs to the previous occupant.
+	//Until the hitbox moves, every frame from here on holds its starting position.
+	History.EnsureSlotCapacity(HitboxSlots.Num());
+	History.ResetSlot(Index, History.GetNewestFrame() + 1, StateMirror.Positions[Index]);
+	return MakeHitboxID(Index, Slot.Generation);
 }
 
 void UHitboxManager::RegisterNewHitbox(UHitbox* Hitbox, const int32 ID)
@@ -57,8 +839,76 @@ void UHitboxManager::RegisterNewHitbox(UHitbox* Hitbox, const int32 ID)
 	{
 		return;
 	}
-	HitboxMap.Add(ID, Hitbox);
-	//This overload is called on clients, so we don't need to do anything to the snapshot map.
+	//This overload is called on clients, which mirror the server's slot layout from the replicated ID.
+	//Only the server rewinds hitboxes, so clients don't record any history for these slots.
+	const int32 Index = GetHitboxIndex(ID);
+	while (Index >= HitboxSlots.Num())
+	{
+		AddSlot();
+	}
+	HitboxSlots[Index].Hitbox = Hitbox;
+	HitboxSlots[Index].Generation = GetHitboxGeneration(ID);
+}
+
+void UHitboxManager::UnregisterHitbox(UHitbox* Hitbox)
+{
+	if (!IsValid(Hitbox))
+	{
+		return;
+	}
+	const int32 ID = Hitbox->GetHitboxID();
+	const int32 Index = GetHitboxIndex(ID);
+	if (ID == -1 || !HitboxSlots.IsValidIndex(Index))
+	{
+		return;
+	}
+	FHitboxSlot& Slot = HitboxSlots[Index];
+	//On clients, a newer hitbox may already have been replicated into this slot before the old one ended play.
+	if (Slot.Hitbox != Hitbox || Slot.Generation != GetHitboxGeneration(ID))
+	{
+		return;
+	}
+	Slot.Hitbox = nullptr;
+	StateMirror.Clear(Index);
+	if (!GetWorld()->IsNetMode(NM_Client))
+	{
+		//Bumping the generation means any in-flight moves that still reference the old ID will fail to resolve.
+		Slot.Generation = (Slot.Generation + 1) & HitboxGenerationMask;
+		FreeSlots.Add(Index);
+	}
+}
+
+const FHitboxSlot* UHitboxManager::FindSlot(const int32 HitboxID) const
+{
+	if (HitboxID < 0)
+	{
+		return nullptr;
+	}
+	const int32 Index = GetHitboxIndex(HitboxID);
+	if (!HitboxSlots.IsValidIndex(Index))
+	{
+		return nullptr;
+	}
+	const FHitboxSlot& Slot = HitboxSlots[Index];
+	if (Slot.Generation != GetHitboxGeneration(HitboxID) || !IsValid(Slot.Hitbox))
+	{
+		return nullptr;
+	}
+	return &Slot;
+}
+
+UHitbox* UHitboxManager::FindHitbox(const int32 HitboxID) const
+{
+	const FHitboxSlot* Slot = FindSlot(HitboxID);
+	return Slot ? Slot->Hitbox : nullptr;
+}
+
+int32 UHitboxManager::AddSlot()
+{
+	const int32 Index = HitboxSlots.AddDefaulted();
+	StateMirror.SetNum(HitboxSlots.Num());
+	StateMirror.Clear(Index);
+	return Index;
 }
 
 void UHitboxManager::ConfirmCollisionOfHitboxes(const int32 InstigatorID, const int32 TargetID, const bool bDamage, const bool bBounce)
@@ -67,60 +917,81 @@ void UHitboxManager::ConfirmCollisionOfHitboxes(const int32 InstigatorID, const
 	{
 		return;
 	}
-	UHitbox* InstigatorHitbox = HitboxMap.FindRef(InstigatorID);
+	UHitbox* InstigatorHitbox = FindHitbox(InstigatorID);
 	if (!IsValid(InstigatorHitbox))
 	{
 		return;
 	}
-	UHitbox* TargetHitbox = HitboxMap.FindRef(TargetID);
+	UHitbox* TargetHitbox = FindHitbox(TargetID);
 	if (!IsValid(TargetHitbox))
 	{
 		return;
 	}
-	const float Damage = bDamage ? InstigatorHitbox->GetCollisionDamageDone() : 0.0f;
-	const FVector Impulse = bBounce ? InstigatorHitbox->GetBounceImpulse() : FVector::ZeroVector;
+	const int32 InstigatorArchetypeIndex = StateMirror.ArchetypeIndices[GetHitboxIndex(InstigatorID)];
+	const FHitboxArchetypeData InstigatorArchetype = IsArchetypeRegistered(InstigatorArchetypeIndex) ? Archetypes[InstigatorArchetypeIndex] : InstigatorHitbox->GetArchetypeData();
+	const float Damage = bDamage ? InstigatorArchetype.CollisionDamage : 0.0f;
+	const FVector Impulse = bBounce ? InstigatorArchetype.BounceImpulse : FVector::ZeroVector;
 	TargetHitbox->NotifyOfCollisionResult(InstigatorHitbox, Impulse, Damage, FVector::ZeroVector, 0.0f);
 }
 
-FVector UHitboxManager::GetHitboxPositionAtTime(const int32 HitboxID, const float Timestamp) const
+FHitboxRewindFrame UHitboxManager::FindRewindFrame(const double Timestamp) const
 {
-	const UHitbox* Hitbox = HitboxMap.FindRef(HitboxID);
-	if (!IsValid(Hitbox))
-	{
-		return FVector::ZeroVector;
-	}
-	const FHitboxSnapshotArray* SnapshotArray = HitboxSnapshots.Find(HitboxID);
-	//If this hitbox doesn't have a snapshot array or doesn't have snapshots, just return the hitbox's current location.
-	if (!SnapshotArray || SnapshotArray->Snapshots.Num() == 0)
-	{
-		return Hitbox->GetComponentLocation();
-	}
-	//Find a snapshot before the timestamp and a snapshot after the timestamp, and then lerp between them to guess at the position at the timestamp.
-	float TimeAfter = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
-	FVector PositionAfter = Hitbox->GetComponentLocation();
-	float TimeBefore = 0.0f;
-	FVector PositionBefore = FVector::ZeroVector;
-	bool bFoundPositionBefore = false;
-	for (int i = SnapshotArray->Snapshots.Num() - 1; i >= 0; i--)
+	SCOPE_CYCLE_COUNTER(STAT_HitboxRewindQuery);
+	return History.FindRewindFrame(Timestamp, GetWorld()->GetGameState()->GetServerWorldTimeSeconds());
+}
+
+FVector UHitboxManager::GetHitboxPositionAtFrame(const int32 Index, const FHitboxRewindFrame& RewindFrame) const
+{
+	FVector Position;
+	RewindHitboxPositions(MakeArrayView(&Index, 1), MakeArrayView(&RewindFrame, 1), MakeArrayView(&Position, 1));
+	return Position;
+}
+
+void UHitboxManager::RewindHitboxPositions(TConstArrayView<int32> Indices, TConstArrayView<FHitboxRewindFrame> RewindFrames, TArrayView<FVector> OutPositions) const
+{
+	check(Indices.Num() == RewindFrames.Num() && Indices.Num() == OutPositions.Num());
+	SCOPE_CYCLE_COUNTER(STAT_HitboxRewindPositions);
+	CSV_SCOPED_TIMING_STAT(Hitboxes, Rewind);
+	FSimpleScopeSecondsCounter RewindTimer(FrameTimings.Rewind);
+	LLM_SCOPE_BYTAG(HitboxRewind);
+	//Gather the positions on either side of every query first, so that the interpolation itself runs over flat arrays.
+	RewindBatch.SetNum(Indices.Num());
+	for (int32 Query = 0; Query < Indices.Num(); Query++)
 	{
-		if (SnapshotArray->Snapshots[i].Timestamp >= Timestamp)
+		const int32 Index = Indices[Query];
+		if (Index == INDEX_NONE)
 		{
-			TimeAfter = SnapshotArray->Snapshots[i].Timestamp;
-			PositionAfter = SnapshotArray->Snapshots[i].Location;
+			RewindBatch.Set(Query, FVector::ZeroVector, FVector::ZeroVector, 0.0f);
+			continue;
 		}
-		else
+		const FHitboxRewindFrame& RewindFrame = RewindFrames[Query];
+		//If there is no frame after the moment, the hitbox's current location stands in for it.
+		const FVector PositionAfter = RewindFrame.AfterFrame == INDEX_NONE ? StateMirror.Positions[Index] : History.GetPosition(RewindFrame.AfterFrame, Index);
+		//If there is no frame before the moment, or the hitbox hadn't registered yet, the after position is the best we have.
+		if (RewindFrame.BeforeFrame == INDEX_NONE || RewindFrame.BeforeFrame < History.GetFirstFrame(Index))
 		{
-			TimeBefore = SnapshotArray->Snapshots[i].Timestamp;
-			PositionBefore = SnapshotArray->Snapshots[i].Location;
-			bFoundPositionBefore = true;
-			break;
+			RewindBatch.Set(Query, PositionAfter, PositionAfter, 0.0f);
+			continue;
 		}
+		RewindBatch.Set(Query, History.GetPosition(RewindFrame.BeforeFrame, Index), PositionAfter, RewindFrame.Alpha);
+	}
+	if (CVarVectorizedHitboxRewind.GetValueOnGameThread())
+	{
+		HitboxCollision::LerpPositions(RewindBatch, OutPositions);
 	}
-	if (!bFoundPositionBefore)
+	else
+	{
+		HitboxCollision::LerpPositionsScalar(RewindBatch, OutPositions);
+	}
+}
+
+FVector UHitboxManager::GetHitboxPositionAtTime(const int32 HitboxID, const double Timestamp) const
+{
+	if (!FindSlot(HitboxID))
 	{
-		return PositionAfter;
+		return FVector::ZeroVector;
 	}
-	return FMath::Lerp(PositionBefore, PositionAfter, FMath::Clamp((Timestamp - TimeBefore) / (TimeAfter - TimeBefore), 0.0f, 1.0f));
+	return GetHitboxPositionAtFrame(GetHitboxIndex(HitboxID), FindRewindFrame(Timestamp));
 }
 
 FVector UHitboxManager::GetBounceImpulseForHitbox(const int32 HitboxID) const
@@ -129,38 +1000,222 @@ FVector UHitboxManager::GetBounceImpulseForHitbox(const int32 HitboxID) const
 	{
 		return FVector::ZeroVector;
 	}
-	const UHitbox* Hitbox = HitboxMap.FindRef(HitboxID);
-	if (IsValid(Hitbox))
+	const UHitbox* Hitbox = FindHitbox(HitboxID);
+	if (!IsValid(Hitbox))
+	{
+		return FVector::ZeroVector;
+	}
+	else if (IsArchetypeRegistered(Hitbox->GetArchetypeIndex()))
 	{
-		return Hitbox->GetBounceImpulse();
+		return Archetypes[Hitbox->GetArchetypeIndex()].BounceImpulse;
 	}
 	else
 	{
-		return FVector::ZeroVector;
+		return Hitbox->GetArchetypeData().BounceImpulse;
 	}
 }
 
-bool UHitboxManager::SanityCheckBounce(const int32 HitboxIDA, const int32 HitboxIDB, const float PingTime) const
+FHitboxCollisionParams UHitboxManager::GetCollisionParams(const int32 Index, const FVector& Location) const
 {
-	const UHitbox* HitboxA = HitboxMap.FindRef(HitboxIDA);
-	if (!IsValid(HitboxA))
+	const int32 ArchetypeIndex = StateMirror.ArchetypeIndices[Index];
+	//A hitbox the server couldn't give an archetype to, because the limit was reached, keeps colliding with its own settings.
+	if (!IsArchetypeRegistered(ArchetypeIndex) && IsValid(HitboxSlots[Index].Hitbox))
 	{
-		return false;
+		const FHitboxArchetypeData Archetype = HitboxSlots[Index].Hitbox->GetArchetypeData();
+		return MakeCollisionParams(Archetype, Archetype.GetCapabilities(), Location, StateMirror.Shapes[Index]);
+	}
+	return MakeCollisionParams(ArchetypeIndex, Location, StateMirror.Shapes[Index]);
+}
+
+FHitboxCollisionParams UHitboxManager::MakeCollisionParams(const int32 ArchetypeIndex, const FVector& Location, const FHitboxShape2D& Shape) const
+{
+	//A hitbox whose archetype hasn't arrived yet collides with default settings rather than reading a gap.
+	if (!IsArchetypeRegistered(ArchetypeIndex))
+	{
+		const FHitboxArchetypeData DefaultArchetype;
+		return MakeCollisionParams(DefaultArchetype, DefaultArchetype.GetCapabilities(), Location, Shape);
+	}
+	return MakeCollisionParams(Archetypes[ArchetypeIndex], ArchetypeCapabilities[ArchetypeIndex], Location, Shape);
+}
+
+FHitboxCollisionParams UHitboxManager::MakeCollisionParams(const FHitboxArchetypeData& Archetype, const EHitboxCapabilities Capabilities, const FVector& Location,
+	const FHitboxShape2D& Shape)
+{
+	FHitboxCollisionParams Params;
+	Params.Location = Location;
+	Params.Radius = Shape.GetBoundingRadius();
+	Params.Shape = Shape;
+	Params.CollisionThreshold = Archetype.CollisionThreshold;
+	Params.Capabilities = Capabilities;
+	Params.BounceImpulse = Archetype.BounceImpulse;
+	Params.CollisionDamage = Archetype.CollisionDamage;
+	return Params;
+}
+
+FHitboxCollisionParams UHitboxManager::GetHitboxCollisionParams(const UHitbox* Hitbox) const
+{
+	const int32 ArchetypeIndex = Hitbox->GetArchetypeIndex();
+	if (!IsArchetypeRegistered(ArchetypeIndex))
+	{
+		const FHitboxArchetypeData Archetype = Hitbox->GetArchetypeData();
+		return MakeCollisionParams(Archetype, Archetype.GetCapabilities(), Hitbox->GetComponentLocation(), Hitbox->GetShape2D());
+	}
+	return MakeCollisionParams(ArchetypeIndex, Hitbox->GetComponentLocation(), Hitbox->GetShape2D());
+}
+
+int32 UHitboxManager::RegisterArchetype(const FHitboxArchetypeData& Data)
+{
+	const int32 Existing = Archetypes.IndexOfByKey(Data);
+	if (Existing != INDEX_NONE)
+	{
+		return Existing;
+	}
+	if (Archetypes.Num() >= MaxArchetypes)
+	{
+		UE_LOG(LogTemp, Error, TEXT("More than %d hitbox archetypes were registered. New hitboxes will use their own settings without an archetype."), MaxArchetypes);
+		return INDEX_NONE;
+	}
+	ArchetypeCapabilities.Add(Data.GetCapabilities());
+	ArchetypesRegistered.Add(true);
+	return Archetypes.Add(Data);
+}
+
+void UHitboxManager::RegisterArchetype(const FHitboxArchetypeData& Data, const int32 ArchetypeIndex)
+{
+	if (!GetWorld()->IsNetMode(NM_Client) || ArchetypeIndex < 0)
+	{
+		return;
+	}
+	if (ArchetypeIndex >= MaxArchetypes)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Archetype index %d is out of range and will be ignored."), ArchetypeIndex);
+		return;
 	}
-	const UHitbox* HitboxB = HitboxMap.FindRef(HitboxIDB);
-	if (!IsValid(HitboxB))
+	if (IsArchetypeRegistered(ArchetypeIndex))
+	{
+		if (!(Archetypes[ArchetypeIndex] == Data))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Archetype %d was registered again with different settings. The first settings are kept."), ArchetypeIndex);
+		}
+		return;
+	}
+	if (ArchetypeIndex >= Archetypes.Num())
+	{
+		Archetypes.SetNum(ArchetypeIndex + 1);
+		ArchetypeCapabilities.SetNum(ArchetypeIndex + 1);
+		ArchetypesRegistered.SetNumZeroed(ArchetypeIndex + 1);
+	}
+	Archetypes[ArchetypeIndex] = Data;
+	ArchetypeCapabilities[ArchetypeIndex] = Data.GetCapabilities();
+	ArchetypesRegistered[ArchetypeIndex] = true;
+}
+
+bool UHitboxManager::CanHitboxBounceOff(const int32 ThisHitboxID, const int32 OtherHitboxID, const double CollisionTime) const
+{
+	const FHitboxSlot* ThisSlot = FindSlot(ThisHitboxID);
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (!ThisSlot || !FindSlot(OtherHitboxID) || CollisionTime < 0.0 || !IsValid(GameState))
 	{
 		return false;
 	}
-	//If we have no game state reference, things have gone wrong.
-	if (!IsValid(GetWorld()->GetGameState()))
+	const int32 ThisIndex = GetHitboxIndex(ThisHitboxID);
+	const int32 OtherIndex = GetHitboxIndex(OtherHitboxID);
+	if (!StateMirror.HasFlags(ThisIndex, EHitboxStateFlags::Enabled) || !StateMirror.HasFlags(OtherIndex, EHitboxStateFlags::Enabled))
 	{
 		return false;
 	}
-	const float CurrentTime = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
-	const FVector PositionA = HitboxA->GetComponentLocation();
-	const FVector PositionB = GetHitboxPositionAtTime(HitboxIDB, CurrentTime - PingTime);
-	//We multiply the distance the hitboxes can be apart by a multiplier because ping isn't 100% accurate and we are also estimating based on lerping for position.
-	return FVector::DistSquared(PositionA, PositionB)
-		< FMath::Square((HitboxA->GetScaledSphereRadius() + HitboxB->GetScaledSphereRadius()) * HitboxToleranceMultiplier);
+	const FHitboxRewindFrame RewindFrame = FindRewindFrame(ClampRewindTime(CollisionTime, GameState->GetServerWorldTimeSeconds()));
+	const FVector OtherLocation = GetHitboxPositionAtFrame(OtherIndex, RewindFrame);
+	FHitboxCollisionOutcome Outcome;
+	Outcome.bBouncedThis = true;
+	HitboxCollision::ReplayCollision(GetCollisionParams(ThisIndex, ThisSlot->Hitbox->GetComponentLocation()), GetCollisionParams(OtherIndex, OtherLocation),
+		HitboxToleranceMultiplier, static_cast<float>(History.GetPositionError()), Outcome);
+	return Outcome.bBouncedThis;
+}
+
+void UHitboxManager::QueueCollisionValidation(const int32 ThisHitboxID, const int32 OtherHitboxID, const double CollisionTime, const FHitboxCollisionOutcome& Outcome)
+{
+	const FHitboxSlot* ThisSlot = FindSlot(ThisHitboxID);
+	if (!ThisSlot || !Outcome.HasAnyOutcome())
+	{
+		return;
+	}
+	FHitboxValidationRequest& Request = PendingValidations.AddDefaulted_GetRef();
+	Request.ThisHitboxID = ThisHitboxID;
+	Request.OtherHitboxID = OtherHitboxID;
+	Request.CollisionTime = CollisionTime;
+	//The server is simulating the move that reported this collision right now, so the hitbox's current location is where it was when the collision happened.
+	//By the time the request is validated the move will have finished, so the location has to be captured here.
+	Request.ThisLocation = ThisSlot->Hitbox->GetComponentLocation();
+	Request.Outcome = Outcome;
+}
+
+void UHitboxManager::ValidatePendingCollisions(const double CurrentTime)
+{
+	if (PendingValidations.Num() == 0)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_HitboxValidateCollisions);
+	CSV_SCOPED_TIMING_STAT(Hitboxes, Validate);
+	FSimpleScopeSecondsCounter ValidateTimer(FrameTimings.Validate);
+	LLM_SCOPE_BYTAG(HitboxValidate);
+	const int32 NumRequests = PendingValidations.Num();
+	FrameTimings.NumValidations = NumRequests;
+	SET_DWORD_STAT(STAT_HitboxNumValidations, NumRequests);
+	//Sort by the rewound hitbox and then by time, so that requests running next to each other read the same history column in order.
+	PendingValidations.Sort([](const FHitboxValidationRequest& A, const FHitboxValidationRequest& B)
+	{
+		const int32 IndexA = GetHitboxIndex(A.OtherHitboxID);
+		const int32 IndexB = GetHitboxIndex(B.OtherHitboxID);
+		return IndexA != IndexB ? IndexA < IndexB : A.CollisionTime < B.CollisionTime;
+	});
+	//Find the moment each request rewinds to, then rewind every request's other hitbox in one batch.
+	TArray<int32> RewindIndices;
+	RewindIndices.SetNumUninitialized(NumRequests);
+	TArray<FHitboxRewindFrame> RewindFrames;
+	RewindFrames.SetNum(NumRequests);
+	for (int32 Request = 0; Request < NumRequests; Request++)
+	{
+		const FHitboxValidationRequest& ValidationRequest = PendingValidations[Request];
+		//Either hitbox may have unregistered since the request was queued.
+		const bool bValid = FindSlot(ValidationRequest.ThisHitboxID) && FindSlot(ValidationRequest.OtherHitboxID) && ValidationRequest.CollisionTime >= 0.0;
+		RewindIndices[Request] = bValid ? GetHitboxIndex(ValidationRequest.OtherHitboxID) : INDEX_NONE;
+	}
+	ParallelFor(NumRequests, [this, CurrentTime, &RewindIndices, &RewindFrames](const int32 Request)
+	{
+		if (RewindIndices[Request] == INDEX_NONE)
+		{
+			return;
+		}
+		SCOPE_CYCLE_COUNTER(STAT_HitboxRewindQuery);
+		RewindFrames[Request] = History.FindRewindFrame(ClampRewindTime(PendingValidations[Request].CollisionTime, CurrentTime), CurrentTime);
+	});
+	TArray<FVector> RewoundPositions;
+	RewoundPositions.SetNumUninitialized(NumRequests);
+	RewindHitboxPositions(RewindIndices, RewindFrames, RewoundPositions);
+	ParallelFor(NumRequests, [this, &RewindIndices, &RewoundPositions](const int32 Request)
+	{
+		if (RewindIndices[Request] == INDEX_NONE)
+		{
+			PendingValidations[Request].Outcome = FHitboxCollisionOutcome();
+			return;
+		}
+		ValidateCollision(PendingValidations[Request], RewoundPositions[Request]);
+	});
+	//Applying the results broadcasts gameplay events, so this has to stay on the game thread.
+	for (const FHitboxValidationRequest& Request : PendingValidations)
+	{
+		ConfirmCollisionOfHitboxes(Request.ThisHitboxID, Request.OtherHitboxID, Request.Outcome.bDamagedOther, Request.Outcome.bBouncedOther);
+		ConfirmCollisionOfHitboxes(Request.OtherHitboxID, Request.ThisHitboxID, Request.Outcome.bDamagedThis, false);
+	}
+	PendingValidations.Reset();
+}
+
+void UHitboxManager::ValidateCollision(FHitboxValidationRequest& Request, const FVector& OtherLocation) const
+{
+	const FHitboxCollisionParams ThisParams = GetCollisionParams(GetHitboxIndex(Request.ThisHitboxID), Request.ThisLocation);
+	const FHitboxCollisionParams OtherParams = GetCollisionParams(GetHitboxIndex(Request.OtherHitboxID), OtherLocation);
+	//Only the other hitbox is rewound, so only its position can carry the history's rounding error.
+	HitboxCollision::ReplayCollision(ThisParams, OtherParams, HitboxToleranceMultiplier, static_cast<float>(History.GetPositionError()), Request.Outcome);
 }
\ No newline at end of file
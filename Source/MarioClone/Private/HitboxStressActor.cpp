@@ -0,0 +1,28 @@
+﻿#include "HitboxStressActor.h"
+#include "Hitbox.h"
+
+AHitboxStressActor::AHitboxStressActor()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	Hitbox = CreateDefaultSubobject<UHitbox>(TEXT("Hitbox"));
+	SetRootComponent(Hitbox);
+}
+
+void AHitboxStressActor::InitStressMotion(const EHostility InHostility, const FVector& InCenter, const FVector& InAmplitude, const float InPeriod, const float InPhase)
+{
+	Hostility = InHostility;
+	Center = InCenter;
+	Amplitude = InAmplitude;
+	Period = FMath::Max(InPeriod, UE_KINDA_SMALL_NUMBER);
+	Phase = InPhase;
+}
+
+void AHitboxStressActor::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	//The path only depends on time since spawning, so every run of the stress test moves the hitboxes the same way.
+	Elapsed += DeltaTime;
+	SetActorLocation(Center + Amplitude * FMath::Sin(UE_TWO_PI * Elapsed / Period + Phase));
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+﻿#include "HitboxStressTest.h"
+#include "Hitbox.h"
+#include "HitboxManager.h"
+#include "HitboxStressActor.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static void StartHitboxStressTest(const TArray<FString>& Args, UWorld* World)
+{
+	if (!IsValid(World) || !World->IsGameWorld() || World->IsNetMode(NM_Client))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("The hitbox stress test can only run on the server of a game world."));
+		return;
+	}
+	UHitboxStressTest* StressTest = World->GetSubsystem<UHitboxStressTest>();
+	if (!IsValid(StressTest) || StressTest->IsRunning())
+	{
+		return;
+	}
+	const int32 NumHitboxes = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 500;
+	const int32 NumFrames = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 300;
+	const bool bStorm = Args.Num() > 2 && FCString::Atoi(*Args[2]) != 0;
+	StressTest->StartStressTest(NumHitboxes, NumFrames, bStorm);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HitboxStressTestCommand(
+	TEXT("Hitboxes.StressTest"),
+	TEXT("Spawns moving hitboxes and writes the hitbox manager's per-frame timings to a CSV in the profiling directory. Arguments: [NumHitboxes=500] [NumFrames=300] [Storm=0]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartHitboxStressTest));
+
+TStatId UHitboxStressTest::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHitboxStressTest, STATGROUP_Hitboxes);
+}
+
+void UHitboxStressTest::StartStressTest(const int32 NumHitboxes, const int32 NumFrames, const bool bInStorm)
+{
+	bStorm = bInStorm;
+	FramesRemaining = FMath::Max(NumFrames, 1);
+	FrameNumber = 0;
+	Stream.Initialize(NumHitboxes);
+	CsvLines.Reset();
+	CsvLines.Add(TEXT("Frame,DeltaMs,Hitboxes,TickMs,RegisterMs,BroadphaseMs,ResolveContactsMs,RewindMs,ValidateMs,Contacts,Validations,OverlapEvents,ManagerBytes,RegisterLLMBytes,BroadphaseLLMBytes,RewindLLMBytes,ValidateLLMBytes,UsedPhysicalDelta"));
+	StartUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+
+	const int32 Columns = FMath::Max(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumHitboxes))), 1);
+	for (int32 Index = 0; Index < NumHitboxes; Index++)
+	{
+		const FVector Center = bStorm
+			? FVector(Stream.FRandRange(-StormRadius, StormRadius), 0.0f, StressOriginZ + Stream.FRandRange(-StormRadius, StormRadius))
+			: FVector((Index % Columns) * GridSpacing, 0.0f, StressOriginZ + (Index / Columns) * GridSpacing);
+		const FTransform SpawnTransform(Center);
+		AHitboxStressActor* StressActor = GetWorld()->SpawnActorDeferred<AHitboxStressActor>(AHitboxStressActor::StaticClass(), SpawnTransform,
+			nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if (!IsValid(StressActor))
+		{
+			continue;
+		}
+		//Neighbors alternate hostility and swing into each other's space, so there is a steady stream of new contacts.
+		StressActor->InitStressMotion(Index % 2 == 0 ? EHostility::Enemy : EHostility::Friendly, Center,
+			FVector(GridSpacing, 0.0f, 0.0f), Stream.FRandRange(0.5f, 2.0f), Stream.FRandRange(0.0f, UE_TWO_PI));
+		StressActor->FinishSpawning(SpawnTransform);
+		StressActors.Add(StressActor);
+	}
+	bRunning = true;
+	UE_LOG(LogTemp, Log, TEXT("Started hitbox stress test with %d hitboxes for %d frames%s."), StressActors.Num(), FramesRemaining, bStorm ? TEXT(" as a storm") : TEXT(""));
+}
+
+void UHitboxStressTest::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!bRunning)
+	{
+		return;
+	}
+	const UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	if (!IsValid(HitboxManager))
+	{
+		FinishStressTest();
+		return;
+	}
+	//Subsystems tick in no particular order, so this may be the manager's previous frame. Every frame still gets exactly one line.
+	const FHitboxFrameTimings& Timings = HitboxManager->GetLastFrameTimings();
+	const int64 UsedPhysicalDelta = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(StartUsedPhysical);
+	CsvLines.Add(FString::Printf(TEXT("%d,%.3f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%llu,%lld,%lld,%lld,%lld,%lld"),
+		FrameNumber, DeltaTime * 1000.0f, Timings.NumHitboxes,
+		Timings.Tick * 1000.0, Timings.Register * 1000.0, Timings.Broadphase * 1000.0, Timings.ResolveContacts * 1000.0,
+		Timings.Rewind * 1000.0, Timings.Validate * 1000.0, Timings.NumContacts, Timings.NumValidations, Timings.NumOverlapEvents,
+		static_cast<uint64>(Timings.AllocatedBytes), Timings.RegisterTrackedBytes, Timings.BroadphaseTrackedBytes, Timings.RewindTrackedBytes,
+		Timings.ValidateTrackedBytes, UsedPhysicalDelta));
+	FrameNumber++;
+	QueueValidations();
+	if (--FramesRemaining <= 0)
+	{
+		FinishStressTest();
+	}
+}
+
+void UHitboxStressTest::QueueValidations()
+{
+	UHitboxManager* HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (!IsValid(HitboxManager) || !IsValid(GameState) || StressActors.Num() < 2)
+	{
+		return;
+	}
+	const double Now = GameState->GetServerWorldTimeSeconds();
+	//Only bounces to the reporting hitbox are claimed. Validation checks those like any other outcome, but the server never applies them,
+	//so the stress hitboxes don't damage each other.
+	FHitboxCollisionOutcome Outcome;
+	Outcome.bBouncedThis = true;
+	const int32 NumValidations = FMath::Max(StressActors.Num() / 10, 1);
+	for (int32 Validation = 0; Validation < NumValidations; Validation++)
+	{
+		//Hostility alternates by index, so pairing an even index with the next one always gives two hitboxes that can collide.
+		const int32 First = Stream.RandRange(0, StressActors.Num() / 2 - 1) * 2;
+		const AHitboxStressActor* ThisActor = StressActors[First];
+		const AHitboxStressActor* OtherActor = StressActors[First + 1];
+		if (!IsValid(ThisActor) || !IsValid(OtherActor))
+		{
+			continue;
+		}
+		HitboxManager->QueueCollisionValidation(ThisActor->GetHitbox()->GetHitboxID(), OtherActor->GetHitbox()->GetHitboxID(),
+			Now - Stream.FRandRange(0.0f, MaxValidationLatency), Outcome);
+	}
+}
+
+void UHitboxStressTest::FinishStressTest()
+{
+	bRunning = false;
+	for (AHitboxStressActor* StressActor : StressActors)
+	{
+		if (IsValid(StressActor))
+		{
+			StressActor->Destroy();
+		}
+	}
+	const int32 NumHitboxes = StressActors.Num();
+	StressActors.Empty();
+	const FString FileName = FString::Printf(TEXT("HitboxStress_%d%s_%s.csv"), NumHitboxes, bStorm ? TEXT("_Storm") : TEXT(""), *FDateTime::Now().ToString());
+	const FString FilePath = FPaths::Combine(FPaths::ProfilingDir(), FileName);
+	if (FFileHelper::SaveStringArrayToFile(CsvLines, *FilePath))
+	{
+		ResultsPath = FilePath;
+		UE_LOG(LogTemp, Log, TEXT("Hitbox stress test finished, results written to %s."), *FilePath);
+	}
+	else
+	{
+		ResultsPath.Reset();
+		UE_LOG(LogTemp, Error, TEXT("Hitbox stress test finished, but the results couldn't be written to %s."), *FilePath);
+	}
+	CsvLines.Empty();
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 ﻿#include "Killbox.h"
 
 #include "CombatInterface.h"
+#include "TriggerRegionManager.h"
 #include "Components/BoxComponent.h"
+#include "GameFramework/Pawn.h"
 
 const FName AKillbox::KillBoxProfile = FName(TEXT("Killbox"));
 
@@ -20,14 +22,48 @@ void AKillbox::BeginPlay()
 
 	if (GetNetMode() != NM_Client)
 	{
-		CollisionBox->OnComponentBeginOverlap.AddDynamic(this, &AKillbox::OnCollision);
+		UTriggerRegionManager* TriggerManager = GetWorld()->GetSubsystem<UTriggerRegionManager>();
+		if (IsValid(TriggerManager) && TriggerManager->IsUsingRegionGrid())
+		{
+			TriggerRegionID = TriggerManager->RegisterBoxRegion(CollisionBox->Bounds.GetBox(),
+				FTriggerRegionCallback::CreateUObject(this, &AKillbox::OnRegionEntered));
+			CollisionBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		}
+		else
+		{
+			CollisionBox->OnComponentBeginOverlap.AddDynamic(this, &AKillbox::OnCollision);
+		}
 	}
 }
 
+void AKillbox::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (TriggerRegionID != INDEX_NONE)
+	{
+		UTriggerRegionManager* TriggerManager = GetWorld()->GetSubsystem<UTriggerRegionManager>();
+		if (IsValid(TriggerManager))
+		{
+			TriggerManager->UnregisterRegion(TriggerRegionID);
+		}
+		TriggerRegionID = INDEX_NONE;
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 void AKillbox::OnCollision(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
-	if (OtherActor->Implements<UCombatInterface>())
+	KillActor(OtherActor);
+}
+
+void AKillbox::KillActor(AActor* Actor)
+{
+	if (Actor->Implements<UCombatInterface>())
 	{
-		ICombatInterface::Execute_InstantKill(OtherActor);
+		ICombatInterface::Execute_InstantKill(Actor);
 	}
+}
+
+void AKillbox::OnRegionEntered(APawn* Pawn)
+{
+	KillActor(Pawn);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 ﻿#include "LevelGoal.h"
 
 #include "MarioPlayerCharacter.h"
+#include "TriggerRegionManager.h"
 #include "Components/SphereComponent.h"
 
 FName ALevelGoal::GoalCollisionProfile = FName(TEXT("LevelGoal"));
@@ -18,7 +19,31 @@ void ALevelGoal::BeginPlay()
 {
 	Super::BeginPlay();
 
-	CollisionBox->OnComponentBeginOverlap.AddDynamic(this, &ALevelGoal::OnOverlap);
+	UTriggerRegionManager* TriggerManager = GetWorld()->GetSubsystem<UTriggerRegionManager>();
+	if (HasAuthority() && IsValid(TriggerManager) && TriggerManager->IsUsingRegionGrid())
+	{
+		TriggerRegionID = TriggerManager->RegisterSphereRegion(CollisionBox->GetComponentLocation(), CollisionBox->GetScaledSphereRadius(),
+			FTriggerRegionCallback::CreateUObject(this, &ALevelGoal::OnRegionEntered));
+		CollisionBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+	else
+	{
+		CollisionBox->OnComponentBeginOverlap.AddDynamic(this, &ALevelGoal::OnOverlap);
+	}
+}
+
+void ALevelGoal::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (TriggerRegionID != INDEX_NONE)
+	{
+		UTriggerRegionManager* TriggerManager = GetWorld()->GetSubsystem<UTriggerRegionManager>();
+		if (IsValid(TriggerManager))
+		{
+			TriggerManager->UnregisterRegion(TriggerRegionID);
+		}
+		TriggerRegionID = INDEX_NONE;
+	}
+	Super::EndPlay(EndPlayReason);
 }
 
 void ALevelGoal::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
@@ -28,7 +53,12 @@ void ALevelGoal::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* Oth
 	{
 		return;
 	}
-	const AMarioPlayerCharacter* OverlappingPlayer = Cast<AMarioPlayerCharacter>(OtherActor);
+	CheckGoalReached(OtherActor);
+}
+
+void ALevelGoal::CheckGoalReached(AActor* Actor)
+{
+	const AMarioPlayerCharacter* OverlappingPlayer = Cast<AMarioPlayerCharacter>(Actor);
 	if (IsValid(OverlappingPlayer))
 	{
 		AMarioGameState* GameState = Cast<AMarioGameState>(GetWorld()->GetGameState());
@@ -38,3 +68,8 @@ void ALevelGoal::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* Oth
 		}
 	}
 }
+
+void ALevelGoal::OnRegionEntered(APawn* Pawn)
+{
+	CheckGoalReached(Pawn);
+}
@@ -1,7 +1,19 @@
 ﻿#include "MarioMovementComponent.h"
 #include "HitboxManager.h"
+#include "TileCollisionManager.h"
+#include "Components/CapsuleComponent.h"
 #include "GameFramework/Character.h"
-#include "GameFramework/PlayerState.h"
+#include "GameFramework/GameStateBase.h"
+#include "Serialization/BitWriter.h"
+
+DECLARE_STATS_GROUP(TEXT("MarioMovement"), STATGROUP_MarioMovement, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Move Collision Bits Sent"), STAT_MarioMoveCollisionBits, STATGROUP_MarioMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Move Collision Bits Sent (Unpacked)"), STAT_MarioMoveCollisionUnpackedBits, STATGROUP_MarioMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Saved Moves Allocated"), STAT_MarioSavedMovesAllocated, STATGROUP_MarioMovement);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Saved Moves Allocated Total"), STAT_MarioSavedMovesAllocatedTotal, STATGROUP_MarioMovement);
+//Perform Movement divided by Characters Moved is the cost of moving one character, to compare tile collision against physics queries.
+DECLARE_CYCLE_STAT(TEXT("Perform Movement"), STAT_MarioPerformMovement, STATGROUP_MarioMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Characters Moved"), STAT_MarioCharactersMoved, STATGROUP_MarioMovement);
 
 #pragma region SavedMove
 
@@ -13,12 +25,7 @@ void UMarioMovementComponent::FSavedMove_Mario::SetMoveFor(ACharacter* C, float
 	if (IsValid(MovementComponent))
 	{
 		bSavedWantsBounce = MovementComponent->bWantsBounce;
-		SavedThisBounceBoxID = MovementComponent->ThisHitboxID;
-		SavedOtherBounceBoxID = MovementComponent->OtherHitboxID;
-		bSavedBouncedThis = MovementComponent->bBouncedThis;
-		bSavedBouncedOther = MovementComponent->bBouncedOther;
-		bSavedDamagedThis = MovementComponent->bDamagedThis;
-		bSavedDamagedOther = MovementComponent->bDamagedOther;
+		SavedCollisionEvents = MovementComponent->CollisionEvents;
 	}
 }
 
@@ -30,12 +37,7 @@ void UMarioMovementComponent::FSavedMove_Mario::PrepMoveFor(ACharacter* C)
 	if (IsValid(MovementComponent))
 	{
 		MovementComponent->bWantsBounce = bSavedWantsBounce;
-		MovementComponent->ThisHitboxID = SavedThisBounceBoxID;
-		MovementComponent->OtherHitboxID = SavedOtherBounceBoxID;
-		MovementComponent->bBouncedThis = bSavedBouncedThis;
-		MovementComponent->bBouncedOther = bSavedBouncedOther;
-		MovementComponent->bDamagedThis = bSavedDamagedThis;
-		MovementComponent->bDamagedOther = bSavedDamagedOther;
+		MovementComponent->CollisionEvents = SavedCollisionEvents;
 	}
 }
 
@@ -43,12 +45,7 @@ void UMarioMovementComponent::FSavedMove_Mario::Clear()
 {
 	Super::Clear();
 	bSavedWantsBounce = false;
-	SavedThisBounceBoxID = -1;
-	SavedOtherBounceBoxID = -1;
-	bSavedBouncedThis = false;
-	bSavedBouncedOther = false;
-	bSavedDamagedThis = false;
-	bSavedDamagedOther = false;
+	SavedCollisionEvents.Reset();
 }
 
 bool UMarioMovementComponent::FSavedMove_Mario::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
@@ -57,14 +54,11 @@ bool UMarioMovementComponent::FSavedMove_Mario::CanCombineWith(const FSavedMoveP
 	{
 		return false;
 	}
+	//Collisions have to stay attached to the move they happened before, so only moves without any can be combined.
+	//Idle moves never have collisions, so they combine just like they would without hitboxes.
 	const FSavedMove_Mario* NewMoveCast = static_cast<FSavedMove_Mario*>(NewMove.Get());
-	return bSavedWantsBounce == NewMoveCast->bSavedWantsBounce
-		&& SavedThisBounceBoxID == NewMoveCast->SavedThisBounceBoxID
-		&& SavedOtherBounceBoxID == NewMoveCast->SavedOtherBounceBoxID
-		&& bSavedBouncedThis == NewMoveCast->bSavedBouncedThis
-		&& bSavedBouncedOther == NewMoveCast->bSavedBouncedOther
-		&& bSavedDamagedThis == NewMoveCast->bSavedDamagedThis
-		&& bSavedDamagedOther == NewMoveCast->bSavedDamagedOther;
+	return SavedCollisionEvents.IsEmpty() && NewMoveCast->SavedCollisionEvents.IsEmpty()
+		&& bSavedWantsBounce == NewMoveCast->bSavedWantsBounce;
 }
 
 uint8 UMarioMovementComponent::FSavedMove_Mario::GetCompressedFlags() const
@@ -94,7 +88,28 @@ UMarioMovementComponent::FNetworkPredictionData_Client_Mario::FNetworkPrediction
 
 FSavedMovePtr UMarioMovementComponent::FNetworkPredictionData_Client_Mario::AllocateNewMove()
 {
-	return MakeShared<FSavedMove_Mario>(FSavedMove_Mario());
+	//The per frame counter should stay at zero once the pool is filled. Anything else means moves are leaking or the pool is too small.
+	INC_DWORD_STAT(STAT_MarioSavedMovesAllocated);
+	INC_DWORD_STAT(STAT_MarioSavedMovesAllocatedTotal);
+	NumAllocatedMoves++;
+	return MakeShared<FSavedMove_Mario>();
+}
+
+FSavedMovePtr UMarioMovementComponent::FNetworkPredictionData_Client_Mario::CreateSavedMove(ACharacter* C, const float DeltaTime, const FVector& NewAccel)
+{
+	//Prediction data is also created on the server and for simulated proxies, which never save moves, so the pool is only filled once one is needed.
+	//The base class only allocates moves when the pool is empty, so filling it here keeps allocations out of the rest of gameplay.
+	if (!bPreallocatedMoves && IsValid(C) && C->GetLocalRole() == ROLE_AutonomousProxy)
+	{
+		bPreallocatedMoves = true;
+		SavedMoves.Reserve(MaxSavedMoveCount);
+		FreeMoves.Reserve(FMath::Max(MaxFreeMoveCount, PreallocatedMoveCount));
+		while (FreeMoves.Num() < PreallocatedMoveCount)
+		{
+			FreeMoves.Push(AllocateNewMove());
+		}
+	}
+	return Super::CreateSavedMove(C, DeltaTime, NewAccel);
 }
 
 FNetworkPredictionData_Client* UMarioMovementComponent::GetPredictionData_Client() const
@@ -107,6 +122,11 @@ FNetworkPredictionData_Client* UMarioMovementComponent::GetPredictionData_Client
 	return ClientPredictionData;
 }
 
+int32 UMarioMovementComponent::GetNumAllocatedSavedMoves() const
+{
+	return ClientPredictionData ? static_cast<const FNetworkPredictionData_Client_Mario*>(ClientPredictionData)->NumAllocatedMoves : 0;
+}
+
 #pragma endregion
 #pragma region NetworkMoveData
 
@@ -115,25 +135,86 @@ void UMarioMovementComponent::FMarioNetworkMoveData::ClientFillNetworkMoveData(c
 	Super::ClientFillNetworkMoveData(ClientMove, MoveType);
 	
 	const FSavedMove_Mario& CastMove = static_cast<const FSavedMove_Mario&>(ClientMove);
-	ThisBounceBoxID = CastMove.SavedThisBounceBoxID;
-	OtherBounceBoxID = CastMove.SavedOtherBounceBoxID;
-	bBouncedThis = CastMove.bSavedBouncedThis;
-	bBouncedOther = CastMove.bSavedBouncedOther;
-	bDamagedThis = CastMove.bSavedDamagedThis;
-	bDamagedOther = CastMove.bSavedDamagedOther;
+	CollisionEvents = CastMove.SavedCollisionEvents;
 }
 
 bool UMarioMovementComponent::FMarioNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType)
 {
 	const bool bResult = Super::Serialize(CharacterMovement, Ar, PackageMap, MoveType);
-	SerializeOptionalValue(Ar.IsSaving(), Ar, ThisBounceBoxID, -1);
-	SerializeOptionalValue(Ar.IsSaving(), Ar, OtherBounceBoxID, -1);
-	Ar << bBouncedThis;
-	Ar << bBouncedOther;
-	Ar << bDamagedThis;
-	Ar << bDamagedOther;
+	//Clients always write their moves with a bit writer, so its position tells us what the collisions really cost.
+	const FBitWriter* BitWriter = Ar.IsSaving() && Ar.IsNetArchive() ? static_cast<const FBitWriter*>(&Ar) : nullptr;
+	const int64 StartBits = BitWriter ? BitWriter->GetNumBits() : 0;
+	//Almost every move has no collision, and those only cost this one bit.
+	uint8 bHasCollision = Ar.IsSaving() && !CollisionEvents.IsEmpty() ? 1 : 0;
+	Ar.SerializeBits(&bHasCollision, 1);
+	if (bHasCollision)
+	{
+		uint32 ExtraEvents = Ar.IsSaving() ? CollisionEvents.Num - 1 : 0;
+		Ar.SerializeInt(ExtraEvents, FMarioCollisionEvents::Capacity);
+		uint16 FirstSequence = CollisionEvents.Events[0].Sequence;
+		Ar << FirstSequence;
+		if (Ar.IsLoading())
+		{
+			CollisionEvents.Num = FMath::Min(static_cast<int32>(ExtraEvents) + 1, FMarioCollisionEvents::Capacity);
+		}
+		for (int32 EventIndex = 0; EventIndex < CollisionEvents.Num; EventIndex++)
+		{
+			FMarioCollisionEvent& Event = CollisionEvents.Events[EventIndex];
+			Event.Sequence = FirstSequence + EventIndex;
+			FHitboxCollisionOutcome& Outcome = Event.Outcome;
+			uint8 OutcomeBits = (Outcome.bBouncedThis ? 1 << 0 : 0) | (Outcome.bBouncedOther ? 1 << 1 : 0) | (Outcome.bDamagedThis ? 1 << 2 : 0) | (Outcome.bDamagedOther ? 1 << 3 : 0);
+			Ar.SerializeBits(&OutcomeBits, 4);
+			Outcome.bBouncedThis = (OutcomeBits & (1 << 0)) != 0;
+			Outcome.bBouncedOther = (OutcomeBits & (1 << 1)) != 0;
+			Outcome.bDamagedThis = (OutcomeBits & (1 << 2)) != 0;
+			Outcome.bDamagedOther = (OutcomeBits & (1 << 3)) != 0;
+			SerializeHitboxID(Ar, Event.ThisHitboxID);
+			SerializeHitboxID(Ar, Event.OtherHitboxID);
+			SerializeOptionalValue(Ar.IsSaving(), Ar, Event.CollisionTime, -1.0);
+		}
+	}
+	else if (Ar.IsLoading())
+	{
+		CollisionEvents.Reset();
+	}
+	if (BitWriter)
+	{
+		INC_DWORD_STAT_BY(STAT_MarioMoveCollisionBits, BitWriter->GetNumBits() - StartBits);
+		INC_DWORD_STAT_BY(STAT_MarioMoveCollisionUnpackedBits, GetUnpackedBits());
+	}
 
-	return bResult;
+	return bResult && !Ar.IsError();
+}
+
+void UMarioMovementComponent::FMarioNetworkMoveData::SerializeHitboxID(FArchive& Ar, int32& HitboxID)
+{
+	//Index 0 is kept for "no hitbox", so real slot indices are sent one higher.
+	uint32 PackedIndex = HitboxID == -1 ? 0 : static_cast<uint32>(UHitboxManager::GetHitboxIndex(HitboxID)) + 1;
+	Ar.SerializeIntPacked(PackedIndex);
+	if (PackedIndex == 0)
+	{
+		HitboxID = -1;
+		return;
+	}
+	uint32 Generation = HitboxID == -1 ? 0 : static_cast<uint32>(UHitboxManager::GetHitboxGeneration(HitboxID));
+	Ar.SerializeIntPacked(Generation);
+	if (Ar.IsLoading())
+	{
+		HitboxID = UHitboxManager::MakeHitboxID(static_cast<int32>(FMath::Min(PackedIndex - 1, static_cast<uint32>(UHitboxManager::HitboxIndexMask))), static_cast<int32>(Generation));
+	}
+}
+
+int32 UMarioMovementComponent::FMarioNetworkMoveData::GetUnpackedBits() const
+{
+	//Three optional values, each with a default bit, and four bools serialized as 32 bit values.
+	//Only the first event could be sent, so any others were lost rather than costing anything.
+	const int32 UnpackedBits = 3 + 4 * 32;
+	if (CollisionEvents.IsEmpty())
+	{
+		return UnpackedBits;
+	}
+	const FMarioCollisionEvent& Event = CollisionEvents.Events[0];
+	return UnpackedBits + (Event.ThisHitboxID != -1 ? 32 : 0) + (Event.OtherHitboxID != -1 ? 32 : 0) + (Event.CollisionTime != -1.0 ? 64 : 0);
 }
 
 #pragma endregion 
@@ -149,18 +230,174 @@ void UMarioMovementComponent::BeginPlay()
 	Super::BeginPlay();
 
 	HitboxManager = GetWorld()->GetSubsystem<UHitboxManager>();
+	TileCollisionManager = GetWorld()->GetSubsystem<UTileCollisionManager>();
+}
+
+void UMarioMovementComponent::PerformMovement(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MarioPerformMovement);
+	INC_DWORD_STAT(STAT_MarioCharactersMoved);
+	Super::PerformMovement(DeltaTime);
+}
+
+bool UMarioMovementComponent::PredictsCollisions() const
+{
+	return PawnOwner->IsLocallyControlled();
+}
+
+bool UMarioMovementComponent::IsUsingTileCollision() const
+{
+	return IsValid(TileCollisionManager) && TileCollisionManager->IsUsingTileCollision() && IsValid(CharacterOwner);
+}
+
+FVector2D UMarioMovementComponent::GetTileCollisionExtent() const
+{
+	float Radius, HalfHeight;
+	CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleSize(Radius, HalfHeight);
+	return FVector2D(Radius, HalfHeight);
+}
+
+bool UMarioMovementComponent::MoveUpdatedComponentImpl(const FVector& Delta, const FQuat& NewRotation, bool bSweep, FHitResult* OutHit, ETeleportType Teleport)
+{
+	if (!bSweep || !UpdatedComponent || !IsUsingTileCollision())
+	{
+		return Super::MoveUpdatedComponentImpl(Delta, NewRotation, bSweep, OutHit, Teleport);
+	}
+	//Find how far we can go against the tiles first. Starting inside a tile is reported as is, so that the movement code pushes us back out.
+	FHitResult TileHit;
+	const bool bTileBlocked = TileCollisionManager->SweepBox(UpdatedComponent->GetComponentLocation(), Delta, GetTileCollisionExtent(), TileHit);
+	if (bTileBlocked && TileHit.bStartPenetrating)
+	{
+		if (OutHit)
+		{
+			*OutHit = TileHit;
+		}
+		return false;
+	}
+	//Other pawns and movable geometry aren't baked into the tiles, so they're swept for separately, only as far as the tiles let us go.
+	//The move itself then doesn't sweep, which would query the static geometry the tiles already covered all over again.
+	const FVector Start = UpdatedComponent->GetComponentLocation();
+	const float AllowedFraction = bTileBlocked ? TileHit.Time : 1.0f;
+	const FVector AllowedDelta = Delta * AllowedFraction;
+	FHitResult PhysicsHit;
+	const bool bPhysicsBlocked = !AllowedDelta.IsNearlyZero() && SweepUnbakedObjects(Start, AllowedDelta, PhysicsHit);
+	const bool bMoved = Super::MoveUpdatedComponentImpl(bPhysicsBlocked ? AllowedDelta * PhysicsHit.Time : AllowedDelta, NewRotation, false, nullptr, Teleport);
+	if (OutHit)
+	{
+		if (bPhysicsBlocked)
+		{
+			//The physics hit's time is along the shortened move, so scale it back to the whole move the caller asked for.
+			PhysicsHit.Time *= AllowedFraction;
+			PhysicsHit.TraceEnd = Start + Delta;
+			*OutHit = PhysicsHit;
+		}
+		else if (bTileBlocked)
+		{
+			*OutHit = TileHit;
+		}
+		else
+		{
+			*OutHit = FHitResult(Start, Start + Delta);
+		}
+	}
+	return bMoved;
+}
+
+bool UMarioMovementComponent::SweepUnbakedObjects(const FVector& Start, const FVector& Delta, FHitResult& OutHit) const
+{
+	if (!IsValid(UpdatedPrimitive))
+	{
+		return false;
+	}
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(MarioUnbakedSweep), false, CharacterOwner);
+	FCollisionResponseParams ResponseParams;
+	UpdatedPrimitive->InitSweepCollisionParams(QueryParams, ResponseParams);
+	TArray<FHitResult> Hits;
+	GetWorld()->SweepMultiByObjectType(Hits, Start, Start + Delta, UpdatedComponent->GetComponentQuat(), ObjectParams, UpdatedPrimitive->GetCollisionShape(), QueryParams);
+	//An object query returns everything of these types, including triggers and hitboxes that only overlap us,
+	//so we stop at the first hit that blocks both ways, the same as a sweep on our own channel would.
+	const ECollisionChannel ObjectType = UpdatedPrimitive->GetCollisionObjectType();
+	const FHitResult* FirstBlock = nullptr;
+	for (const FHitResult& Hit : Hits)
+	{
+		const UPrimitiveComponent* HitComponent = Hit.GetComponent();
+		if (IsValid(HitComponent) && (!FirstBlock || Hit.Time < FirstBlock->Time)
+			&& HitComponent->GetCollisionResponseToChannel(ObjectType) == ECR_Block
+			&& UpdatedPrimitive->GetCollisionResponseToChannel(HitComponent->GetCollisionObjectType()) == ECR_Block)
+		{
+			FirstBlock = &Hit;
+		}
+	}
+	if (!FirstBlock)
+	{
+		return false;
+	}
+	OutHit = *FirstBlock;
+	OutHit.bBlockingHit = true;
+	//Stop just short of the surface, like the tile sweep does, so the next move doesn't start inside it.
+	const float DeltaSize = Delta.Size();
+	OutHit.Time = DeltaSize > UE_KINDA_SMALL_NUMBER ? FMath::Max(0.0f, FirstBlock->Time - 0.1f / DeltaSize) : 0.0f;
+	return true;
+}
+
+void UMarioMovementComponent::ComputeFloorDist(const FVector& CapsuleLocation, float LineDistance, float SweepDistance, FFindFloorResult& OutFloorResult, float SweepRadius, const FHitResult* DownwardSweepResult) const
+{
+	if (!IsUsingTileCollision())
+	{
+		Super::ComputeFloorDist(CapsuleLocation, LineDistance, SweepDistance, OutFloorResult, SweepRadius, DownwardSweepResult);
+		return;
+	}
+	OutFloorResult.Clear();
+	//This follows the physics version: a sweep as wide as SweepRadius, and if that finds something we can't stand on, a line down the middle.
+	//Both start a little above the capsule so a floor we've sunk into is still found, at a negative distance like the physics sweep reports it.
+	const float HalfHeight = GetTileCollisionExtent().Y;
+	const FVector QueryStart = CapsuleLocation + FVector(0.0f, 0.0f, MAX_FLOOR_DIST);
+	if (SweepDistance > 0.0f && SweepRadius > 0.0f)
+	{
+		FHitResult Hit;
+		if (TileCollisionManager->SweepBox(QueryStart, FVector(0.0f, 0.0f, -(SweepDistance + MAX_FLOOR_DIST)), FVector2D(SweepRadius, HalfHeight), Hit))
+		{
+			const float SweepResult = Hit.Distance - MAX_FLOOR_DIST;
+			OutFloorResult.SetFromSweep(Hit, SweepResult, false);
+			if (SweepResult <= SweepDistance && IsWalkable(Hit))
+			{
+				OutFloorResult.bWalkableFloor = true;
+				return;
+			}
+		}
+	}
+	//The line is shorter than the sweep, so it can't find anything the sweep missed, unless the sweep started stuck inside something.
+	if (!OutFloorResult.bBlockingHit && !OutFloorResult.HitResult.bStartPenetrating)
+	{
+		OutFloorResult.FloorDist = SweepDistance;
+		return;
+	}
+	if (LineDistance > 0.0f)
+	{
+		//A box with no width is a line in the X/Z plane.
+		FHitResult Hit;
+		if (TileCollisionManager->SweepBox(QueryStart, FVector(0.0f, 0.0f, -(LineDistance + MAX_FLOOR_DIST)), FVector2D(0.0f, HalfHeight), Hit))
+		{
+			const float LineResult = FMath::Max(Hit.Distance - MAX_FLOOR_DIST, 0.0f);
+			if (LineResult <= LineDistance && IsWalkable(Hit))
+			{
+				OutFloorResult.SetFromLineTrace(Hit, OutFloorResult.FloorDist, LineResult, true);
+				return;
+			}
+		}
+	}
+	OutFloorResult.bWalkableFloor = false;
 }
 
 void UMarioMovementComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel)
 {
 	//This runs on the server, and we copy our network move data into the CMC here to use it during the move.
 	const FMarioNetworkMoveData* MoveData = static_cast<const FMarioNetworkMoveData*>(GetCurrentNetworkMoveData());
-	ThisHitboxID = MoveData->ThisBounceBoxID;
-	OtherHitboxID = MoveData->OtherBounceBoxID;
-	bBouncedThis = MoveData->bBouncedThis;
-	bBouncedOther = MoveData->bBouncedOther;
-	bDamagedThis = MoveData->bDamagedThis;
-	bDamagedOther = MoveData->bDamagedOther;
+	CollisionEvents = MoveData->CollisionEvents;
 	
 	Super::MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
 }
@@ -174,35 +411,36 @@ void UMarioMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeco
 	if (bWantsBounce)
 	{
 		bWantsBounce = false;
-		float PingCompensation = 0.0f;
-		const APlayerState* PlayerState = GetCharacterOwner()->GetPlayerState();
-		if (IsValid(PlayerState))
-		{
-			PingCompensation = PlayerState->GetPingInMilliseconds() / 1000.0f;
-		}
-		if (IsValid(HitboxManager) && (GetOwnerRole() != ROLE_Authority || HitboxManager->SanityCheckBounce(ThisHitboxID, OtherHitboxID, PingCompensation)))
+		const bool bRemoteCollision = GetOwnerRole() == ROLE_Authority && !PredictsCollisions();
+		for (int32 EventIndex = 0; EventIndex < CollisionEvents.Num && IsValid(HitboxManager); EventIndex++)
 		{
-			if (bBouncedThis)
+			const FMarioCollisionEvent& Event = CollisionEvents.Events[EventIndex];
+			if (bRemoteCollision)
+			{
+				//Moves the server hasn't acknowledged are sent again along with newer ones, so the same event can arrive more than once.
+				if (bHasAppliedCollision && static_cast<int16>(Event.Sequence - LastAppliedCollisionSequence) <= 0)
+				{
+					continue;
+				}
+				bHasAppliedCollision = true;
+				LastAppliedCollisionSequence = Event.Sequence;
+			}
+			//Our own bounce has to be applied during this move, so for remote clients it is replayed against the rewound history right here.
+			if (Event.Outcome.bBouncedThis && (!bRemoteCollision || HitboxManager->CanHitboxBounceOff(Event.ThisHitboxID, Event.OtherHitboxID, Event.CollisionTime)))
 			{
-				const FVector BounceImpulse = HitboxManager->GetBounceImpulseForHitbox(OtherHitboxID);
+				const FVector BounceImpulse = HitboxManager->GetBounceImpulseForHitbox(Event.OtherHitboxID);
 				if (BounceImpulse != FVector::ZeroVector)
 				{
 					Launch(BounceImpulse);
 				}
 			}
-			//If we're authority, then we passed the sanity check above and can apply the authoritative effects of the collision.
-			if (GetOwnerRole() == ROLE_Authority && !PawnOwner->IsLocallyControlled())
+			//The effects on other hitboxes are authoritative, so remote clients' collisions are queued to be replayed against the history at the end of the frame.
+			if (bRemoteCollision)
 			{
-				HitboxManager->ConfirmCollisionOfHitboxes(ThisHitboxID, OtherHitboxID, bDamagedOther, bBouncedOther);
-				HitboxManager->ConfirmCollisionOfHitboxes(OtherHitboxID, ThisHitboxID, bDamagedThis, false);
+				HitboxManager->QueueCollisionValidation(Event.ThisHitboxID, Event.OtherHitboxID, Event.CollisionTime, Event.Outcome);
 			}
 		}
-		ThisHitboxID = -1;
-		OtherHitboxID = -1;
-		bBouncedThis = false;
-		bBouncedOther = false;
-		bDamagedThis = false;
-		bDamagedOther = false;
+		CollisionEvents.Reset();
 	}
 }
 
@@ -218,17 +456,35 @@ float UMarioMovementComponent::GetGravityZ() const
 void UMarioMovementComponent::OnHitboxCollision(const int32 ThisID, const int32 OtherID,
 	const bool bThisBounced, const bool bOtherBounced, const bool bThisDamaged, const bool bOtherDamaged)
 {
-	if (!GetPawnOwner()->IsLocallyControlled())
+	if (!PredictsCollisions())
+	{
+		return;
+	}
+	FHitboxCollisionOutcome Outcome;
+	Outcome.bBouncedThis = bThisBounced;
+	Outcome.bBouncedOther = bOtherBounced;
+	Outcome.bDamagedThis = bThisDamaged;
+	Outcome.bDamagedOther = bOtherDamaged;
+	AddCollisionEvent(ThisID, OtherID, Outcome);
+}
+
+void UMarioMovementComponent::AddCollisionEvent(const int32 ThisID, const int32 OtherID, const FHitboxCollisionOutcome& Outcome)
+{
+	if (CollisionEvents.IsFull())
 	{
 		return;
 	}
 	bWantsBounce = true;
-	ThisHitboxID = ThisID;
-	OtherHitboxID = OtherID;
-	bBouncedThis = bThisBounced;
-	bBouncedOther = bOtherBounced;
-	bDamagedThis = bThisDamaged;
-	bDamagedOther = bOtherDamaged;
+	FMarioCollisionEvent Event;
+	Event.Sequence = NextCollisionSequence++;
+	Event.ThisHitboxID = ThisID;
+	Event.OtherHitboxID = OtherID;
+	Event.Outcome = Outcome;
+	//Swept contacts know when during the frame the hitboxes met, which matters at low tick rates where a frame is a long time.
+	const double ContactTime = IsValid(HitboxManager) ? HitboxManager->GetDispatchingContactTime() : -1.0;
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	Event.CollisionTime = ContactTime >= 0.0 ? ContactTime : IsValid(GameState) ? GameState->GetServerWorldTimeSeconds() : -1.0;
+	CollisionEvents.Add(Event);
 }
 
 #pragma endregion 
\ No newline at end of file
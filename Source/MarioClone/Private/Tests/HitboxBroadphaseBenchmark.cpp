@@ -0,0 +1,65 @@
+﻿#include "HitboxManager.h"
+#include "HitboxStressTest.h"
+#include "MarioTestWorld.h"
+#include "Misc/AutomationTest.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHitboxBroadphaseBenchmark, "MarioClone.Hitboxes.Benchmarks.BroadphaseVsPhysics",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Runs the hitbox stress test in a fresh world with thousands of enemies, once with the manager's broadphase and once with physics overlaps,
+//and compares the whole world tick, since physics overlaps are paid for while hitboxes move rather than in the manager's own tick.
+bool FHitboxBroadphaseBenchmark::RunTest(const FString& Parameters)
+{
+	static constexpr int32 WarmupFrames = 30;
+	static constexpr int32 MeasuredFrames = 120;
+	FScopedConsoleVariableOverride UseBroadphase(TEXT("Hitboxes.UseBroadphase"));
+	if (!TestTrue(TEXT("Hitboxes.UseBroadphase exists"), UseBroadphase.IsValid()))
+	{
+		return false;
+	}
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Hitboxes,Source,WorldTickMs,ManagerTickMs,ContactsPerFrame"));
+	for (const int32 NumHitboxes : { 1000, 4000 })
+	{
+		for (const bool bBroadphase : { false, true })
+		{
+			UseBroadphase.Set(bBroadphase);
+			FMarioTestWorld TestWorld;
+			UHitboxStressTest* StressTest = TestWorld.GetWorld()->GetSubsystem<UHitboxStressTest>();
+			const UHitboxManager* HitboxManager = TestWorld.GetWorld()->GetSubsystem<UHitboxManager>();
+			if (!TestNotNull(TEXT("Stress test subsystem exists"), StressTest) || !TestNotNull(TEXT("Hitbox manager exists"), HitboxManager))
+			{
+				continue;
+			}
+			TestEqual(TEXT("Manager uses the requested contact source"), HitboxManager->IsUsingBroadphase(), bBroadphase);
+			StressTest->StartStressTest(NumHitboxes, WarmupFrames + MeasuredFrames, false);
+			TestWorld.TickFrames(WarmupFrames, FMarioTestWorld::FrameTime);
+			double WorldTickSeconds = 0.0;
+			double ManagerTickSeconds = 0.0;
+			int64 NumContacts = 0;
+			for (int32 Frame = 0; Frame < MeasuredFrames; Frame++)
+			{
+				{
+					FSimpleScopeSecondsCounter TickTimer(WorldTickSeconds);
+					TestWorld.Tick(FMarioTestWorld::FrameTime);
+				}
+				ManagerTickSeconds += HitboxManager->GetLastFrameTimings().Tick;
+				NumContacts += HitboxManager->GetLastFrameTimings().NumContacts;
+			}
+			const TCHAR* Source = bBroadphase ? TEXT("Broadphase") : TEXT("Physics");
+			const double WorldTickMs = WorldTickSeconds / MeasuredFrames * 1000.0;
+			const double ManagerTickMs = ManagerTickSeconds / MeasuredFrames * 1000.0;
+			const double ContactsPerFrame = static_cast<double>(NumContacts) / MeasuredFrames;
+			AddInfo(FString::Printf(TEXT("%d hitboxes, %s: %.3f ms per world tick, %.3f ms in the manager, %.1f contacts per frame"),
+				NumHitboxes, Source, WorldTickMs, ManagerTickMs, ContactsPerFrame));
+			CsvLines.Add(FString::Printf(TEXT("%d,%s,%.3f,%.3f,%.1f"), NumHitboxes, Source, WorldTickMs, ManagerTickMs, ContactsPerFrame));
+		}
+	}
+	WriteBenchmarkCsv(*this, TEXT("HitboxBroadphaseBenchmark"), CsvLines);
+	return true;
+}
+
+#endif
\ No newline at end of file
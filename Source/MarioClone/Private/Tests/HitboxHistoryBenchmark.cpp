@@ -0,0 +1,269 @@
+﻿#include "HitboxManager.h"
+#include "MarioTestWorld.h"
+#include "Misc/AutomationTest.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HitboxHistoryBenchmark
+{
+	//The lag compensation history as it was before the ring buffer: an array of snapshots per hitbox ID,
+	//trimmed from the front once it is full and searched from the back when rewinding.
+	struct FLegacySnapshot
+	{
+		float Timestamp = 0.0f;
+		FVector Location = FVector::ZeroVector;
+	};
+
+	class FLegacyHistory
+	{
+	public:
+
+		static constexpr int32 MaxSnapshots = 50;
+
+		void Record(const int32 HitboxID, const float Timestamp, const FVector& Location)
+		{
+			TArray<FLegacySnapshot>& Snapshots = SnapshotMap.FindOrAdd(HitboxID);
+			Snapshots.Add({ Timestamp, Location });
+			while (Snapshots.Num() > MaxSnapshots)
+			{
+				Snapshots.RemoveAt(0);
+			}
+		}
+
+		FVector GetPositionAtTime(const int32 HitboxID, const float Timestamp, const float CurrentTime, const FVector& CurrentLocation) const
+		{
+			const TArray<FLegacySnapshot>* Snapshots = SnapshotMap.Find(HitboxID);
+			if (!Snapshots || Snapshots->Num() == 0)
+			{
+				return CurrentLocation;
+			}
+			float TimeAfter = CurrentTime;
+			FVector PositionAfter = CurrentLocation;
+			for (int32 Snapshot = Snapshots->Num() - 1; Snapshot >= 0; Snapshot--)
+			{
+				const FLegacySnapshot& Recorded = (*Snapshots)[Snapshot];
+				if (Recorded.Timestamp >= Timestamp)
+				{
+					TimeAfter = Recorded.Timestamp;
+					PositionAfter = Recorded.Location;
+					continue;
+				}
+				return FMath::Lerp(Recorded.Location, PositionAfter, FMath::Clamp((Timestamp - Recorded.Timestamp) / (TimeAfter - Recorded.Timestamp), 0.0f, 1.0f));
+			}
+			return PositionAfter;
+		}
+
+		SIZE_T GetAllocatedSize() const
+		{
+			SIZE_T Size = SnapshotMap.GetAllocatedSize();
+			for (const TPair<int32, TArray<FLegacySnapshot>>& Pair : SnapshotMap)
+			{
+				Size += Pair.Value.GetAllocatedSize();
+			}
+			return Size;
+		}
+
+	private:
+
+		TMap<int32, TArray<FLegacySnapshot>> SnapshotMap;
+	};
+
+	//Every hitbox swings back and forth on its own period, so that every hitbox moves every frame. This is the worst case for the history.
+	FVector GetBenchmarkPosition(const int32 Hitbox, const double Time)
+	{
+		const double Phase = Time * (1.0 + (Hitbox % 7) * 0.25) + Hitbox;
+		return FVector(Hitbox * 150.0 + FMath::Sin(Phase) * 100.0, 0.0, FMath::Cos(Phase) * 100.0);
+	}
+
+	struct FQuery
+	{
+		int32 Hitbox = 0;
+		double Timestamp = 0.0;
+	};
+
+	struct FResult
+	{
+		const TCHAR* Implementation = TEXT("");
+		double TickSeconds = 0.0;
+		double QuerySeconds = 0.0;
+		SIZE_T AllocatedBytes = 0;
+		//Largest distance between a rewound position and the legacy history's for the same query.
+		double MaxDeviation = 0.0;
+	};
+
+	static constexpr double FrameTime = 1.0 / 60.0;
+	//Enough frames to fill both histories, so that the measured frames pay for overwriting the oldest entries.
+	static constexpr int32 WarmupFrames = 90;
+	static constexpr int32 MeasuredFrames = 120;
+	static constexpr int32 NumQueries = 20000;
+	//Queries reach back as far as the legacy history does at 60 frames per second.
+	static constexpr double MaxQueryAge = 0.8;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHitboxHistoryBenchmark, "MarioClone.Hitboxes.Benchmarks.History",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Records the same motion into the legacy per-hitbox snapshot arrays and into the frame-major ring, in both of its formats,
+//then times recording and rewinding at 100, 1,000, and 10,000 hitboxes. Results are logged and written to a CSV in the profiling directory.
+bool FHitboxHistoryBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace HitboxHistoryBenchmark;
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Hitboxes,Implementation,TickUs,QueryNs,AllocatedBytes,MaxDeviation"));
+	for (const int32 NumHitboxes : { 100, 1000, 10000 })
+	{
+		FRandomStream Stream(NumHitboxes);
+		const double EndTime = (WarmupFrames + MeasuredFrames) * FrameTime;
+		TArray<FQuery> Queries;
+		Queries.SetNum(NumQueries);
+		for (FQuery& Query : Queries)
+		{
+			Query.Hitbox = Stream.RandRange(0, NumHitboxes - 1);
+			Query.Timestamp = EndTime - Stream.FRandRange(0.0f, static_cast<float>(MaxQueryAge));
+		}
+		TArray<FVector> LegacyPositions;
+		LegacyPositions.SetNumUninitialized(NumQueries);
+		TArray<FResult> Results;
+
+		{
+			FResult& Result = Results.AddDefaulted_GetRef();
+			Result.Implementation = TEXT("Legacy");
+			FLegacyHistory Legacy;
+			for (int32 Frame = 0; Frame < WarmupFrames + MeasuredFrames; Frame++)
+			{
+				const double Time = (Frame + 1) * FrameTime;
+				FSimpleScopeSecondsCounter TickTimer(Result.TickSeconds, Frame >= WarmupFrames);
+				for (int32 Hitbox = 0; Hitbox < NumHitboxes; Hitbox++)
+				{
+					Legacy.Record(Hitbox, static_cast<float>(Time), GetBenchmarkPosition(Hitbox, Time));
+				}
+			}
+			{
+				FSimpleScopeSecondsCounter QueryTimer(Result.QuerySeconds);
+				for (int32 Query = 0; Query < NumQueries; Query++)
+				{
+					const FQuery& ToRun = Queries[Query];
+					LegacyPositions[Query] = Legacy.GetPositionAtTime(ToRun.Hitbox, static_cast<float>(ToRun.Timestamp), static_cast<float>(EndTime),
+						GetBenchmarkPosition(ToRun.Hitbox, EndTime));
+				}
+			}
+			Result.AllocatedBytes = Legacy.GetAllocatedSize();
+		}
+
+		for (const bool bQuantized : { false, true })
+		{
+			FResult& Result = Results.AddDefaulted_GetRef();
+			Result.Implementation = bQuantized ? TEXT("RingQuantized") : TEXT("Ring");
+			FHitboxWorldHistory History;
+			//Sized the way the manager sizes it at 60 frames per second for its one second window.
+			History.Init(64, bQuantized, FVector::ZeroVector);
+			History.EnsureSlotCapacity(NumHitboxes);
+			for (int32 Hitbox = 0; Hitbox < NumHitboxes; Hitbox++)
+			{
+				History.ResetSlot(Hitbox, 0, GetBenchmarkPosition(Hitbox, 0.0));
+			}
+			for (int32 Frame = 0; Frame < WarmupFrames + MeasuredFrames; Frame++)
+			{
+				const double Time = (Frame + 1) * FrameTime;
+				FSimpleScopeSecondsCounter TickTimer(Result.TickSeconds, Frame >= WarmupFrames);
+				History.AddFrame(Time);
+				for (int32 Hitbox = 0; Hitbox < NumHitboxes; Hitbox++)
+				{
+					History.RecordPosition(Hitbox, GetBenchmarkPosition(Hitbox, Time));
+				}
+			}
+			TArray<FVector> Positions;
+			Positions.SetNumUninitialized(NumQueries);
+			{
+				FSimpleScopeSecondsCounter QueryTimer(Result.QuerySeconds);
+				for (int32 Query = 0; Query < NumQueries; Query++)
+				{
+					const FQuery& ToRun = Queries[Query];
+					const FHitboxRewindFrame RewindFrame = History.FindRewindFrame(ToRun.Timestamp, EndTime);
+					const FVector After = RewindFrame.AfterFrame == INDEX_NONE ? GetBenchmarkPosition(ToRun.Hitbox, EndTime) : History.GetPosition(RewindFrame.AfterFrame, ToRun.Hitbox);
+					Positions[Query] = RewindFrame.BeforeFrame == INDEX_NONE ? After
+						: HitboxCollision::LerpPosition(History.GetPosition(RewindFrame.BeforeFrame, ToRun.Hitbox), After, RewindFrame.Alpha);
+				}
+			}
+			Result.AllocatedBytes = History.GetAllocatedSize();
+			for (int32 Query = 0; Query < NumQueries; Query++)
+			{
+				Result.MaxDeviation = FMath::Max(Result.MaxDeviation, FVector::Dist(Positions[Query], LegacyPositions[Query]));
+			}
+			//Both histories interpolate between the same recorded frames, so they should only differ by rounding.
+			TestTrue(FString::Printf(TEXT("%s rewinds to the same positions as the legacy history with %d hitboxes"), Result.Implementation, NumHitboxes),
+				Result.MaxDeviation < 0.1);
+		}
+
+		for (const FResult& Result : Results)
+		{
+			const double TickUs = Result.TickSeconds / MeasuredFrames * 1000000.0;
+			const double QueryNs = Result.QuerySeconds / NumQueries * 1000000000.0;
+			AddInfo(FString::Printf(TEXT("%d hitboxes, %s: %.1f us per tick, %.1f ns per query, %llu bytes"),
+				NumHitboxes, Result.Implementation, TickUs, QueryNs, static_cast<uint64>(Result.AllocatedBytes)));
+			CsvLines.Add(FString::Printf(TEXT("%d,%s,%.3f,%.3f,%llu,%.4f"), NumHitboxes, Result.Implementation, TickUs, QueryNs,
+				static_cast<uint64>(Result.AllocatedBytes), Result.MaxDeviation));
+		}
+	}
+	WriteBenchmarkCsv(*this, TEXT("HitboxHistoryBenchmark"), CsvLines);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHitboxRewindKernelBenchmark, "MarioClone.Hitboxes.Benchmarks.RewindKernels",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Times the interpolation step of rewinding on its own, with the vector kernel that lerps one axis of four queries per register
+//against the scalar loop it replaced. Both run over the same gathered batch, so they must produce the same positions.
+bool FHitboxRewindKernelBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace HitboxHistoryBenchmark;
+	static constexpr int32 NumRepeats = 200;
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Queries,ScalarNs,VectorNs,Speedup"));
+	//An odd count, so that the padded tail of the batch is exercised too.
+	for (const int32 NumBatchQueries : { 15, 1001, NumQueries + 3 })
+	{
+		FRandomStream Stream(NumBatchQueries);
+		FHitboxLerpBatch Batch;
+		Batch.SetNum(NumBatchQueries);
+		for (int32 Query = 0; Query < NumBatchQueries; Query++)
+		{
+			const int32 Hitbox = Stream.RandRange(0, 9999);
+			Batch.Set(Query, GetBenchmarkPosition(Hitbox, 0.0), GetBenchmarkPosition(Hitbox, FrameTime), Stream.FRand());
+		}
+		TArray<FVector> ScalarPositions;
+		TArray<FVector> VectorPositions;
+		ScalarPositions.SetNumUninitialized(NumBatchQueries);
+		VectorPositions.SetNumUninitialized(NumBatchQueries);
+		double ScalarSeconds = 0.0;
+		double VectorSeconds = 0.0;
+		for (int32 Repeat = 0; Repeat < NumRepeats; Repeat++)
+		{
+			{
+				FSimpleScopeSecondsCounter ScalarTimer(ScalarSeconds);
+				HitboxCollision::LerpPositionsScalar(Batch, ScalarPositions);
+			}
+			{
+				FSimpleScopeSecondsCounter VectorTimer(VectorSeconds);
+				HitboxCollision::LerpPositions(Batch, VectorPositions);
+			}
+		}
+		double MaxDeviation = 0.0;
+		for (int32 Query = 0; Query < NumBatchQueries; Query++)
+		{
+			MaxDeviation = FMath::Max(MaxDeviation, FVector::Dist(ScalarPositions[Query], VectorPositions[Query]));
+		}
+		//The vector kernel fuses the multiply and add, so it may round differently in the last bit, but no more.
+		TestTrue(FString::Printf(TEXT("Vector kernel matches the scalar loop for %d queries"), NumBatchQueries), MaxDeviation < UE_DOUBLE_KINDA_SMALL_NUMBER);
+		const double ScalarNs = ScalarSeconds / (NumRepeats * NumBatchQueries) * 1000000000.0;
+		const double VectorNs = VectorSeconds / (NumRepeats * NumBatchQueries) * 1000000000.0;
+		const double Speedup = VectorNs > 0.0 ? ScalarNs / VectorNs : 0.0;
+		AddInfo(FString::Printf(TEXT("%d queries: scalar %.2f ns, vector %.2f ns per query (%.2fx)"), NumBatchQueries, ScalarNs, VectorNs, Speedup));
+		CsvLines.Add(FString::Printf(TEXT("%d,%.3f,%.3f,%.3f"), NumBatchQueries, ScalarNs, VectorNs, Speedup));
+	}
+	WriteBenchmarkCsv(*this, TEXT("HitboxRewindKernelBenchmark"), CsvLines);
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+﻿#include "HitboxManager.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHitboxHistorySparseTest, "MarioClone.Hitboxes.History.SparseRecording",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+//Drives the history with random motion, where most slots sit still for long stretches, slots are handed to new occupants,
+//and the ring and slot count grow partway through. Every slot is read back at every kept frame and compared against a dense copy of the same motion.
+bool FHitboxHistorySparseTest::RunTest(const FString& Parameters)
+{
+	static constexpr int32 InitialSlots = 100;
+	static constexpr int32 GrownSlots = 200;
+	static constexpr int32 NumFrames = 200;
+	for (const bool bQuantized : { false, true })
+	{
+		//Quantized positions are rounded to the nearest step in X and Z, and the history reports how far off that can make them.
+		FHitboxWorldHistory History;
+		History.Init(8, bQuantized, FVector(1000.0, 0.0, -1000.0));
+		const double Tolerance = FMath::Max(History.GetPositionError(), UE_DOUBLE_KINDA_SMALL_NUMBER);
+		FRandomStream Stream(NumFrames);
+		History.EnsureSlotCapacity(InitialSlots);
+		int32 NumSlots = InitialSlots;
+		TArray<FVector> Current;
+		TArray<int64> FirstFrames;
+		for (int32 Slot = 0; Slot < NumSlots; Slot++)
+		{
+			Current.Add(FVector(Slot * 100.0, Slot, 0.0));
+			FirstFrames.Add(0);
+			History.ResetSlot(Slot, 0, Current[Slot]);
+		}
+		//Where every slot was at every frame, indexed by frame number.
+		TArray<TArray<FVector>> Expected;
+		int32 NumMismatches = 0;
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			if (Frame == NumFrames / 3)
+			{
+				History.EnsureFrameCapacity(16);
+			}
+			if (Frame == NumFrames / 2)
+			{
+				History.EnsureSlotCapacity(GrownSlots);
+				for (int32 Slot = NumSlots; Slot < GrownSlots; Slot++)
+				{
+					Current.Add(FVector(Slot * 100.0, Slot, 0.0));
+					FirstFrames.Add(History.GetNewestFrame() + 1);
+					History.ResetSlot(Slot, FirstFrames[Slot], Current[Slot]);
+				}
+				NumSlots = GrownSlots;
+			}
+			//Hand a few slots to new occupants, like hitboxes unregistering and others taking their slots.
+			for (int32 Reset = 0; Reset < 2; Reset++)
+			{
+				const int32 Slot = Stream.RandRange(0, NumSlots - 1);
+				Current[Slot] = FVector(Stream.FRandRange(-5000.0f, 5000.0f), Slot, Stream.FRandRange(-5000.0f, 5000.0f));
+				FirstFrames[Slot] = History.GetNewestFrame() + 1;
+				History.ResetSlot(Slot, FirstFrames[Slot], Current[Slot]);
+			}
+			const int64 HistoryFrame = History.AddFrame(Frame * 0.1);
+			TestEqual(TEXT("Frames are numbered in the order they are added"), HistoryFrame, static_cast<int64>(Frame));
+			for (int32 Slot = 0; Slot < NumSlots; Slot++)
+			{
+				//A quarter of the slots move every frame, and the rest only move now and then.
+				const bool bMoves = Slot % 4 == 0 || Stream.FRand() < 0.05f;
+				if (bMoves)
+				{
+					Current[Slot] += FVector(Stream.FRandRange(-20.0f, 20.0f), 0.0f, Stream.FRandRange(-20.0f, 20.0f));
+					History.RecordPosition(Slot, Current[Slot]);
+				}
+			}
+			Expected.Add(Current);
+
+			for (int64 Read = History.GetOldestFrame(); Read <= History.GetNewestFrame(); Read++)
+			{
+				for (int32 Slot = 0; Slot < NumSlots; Slot++)
+				{
+					//Frames before a slot's occupant registered read as its first frame.
+					const int64 ExpectedFrame = FMath::Max(Read, FirstFrames[Slot]);
+					const FVector& ExpectedPosition = Expected[static_cast<int32>(ExpectedFrame)][Slot];
+					const FVector Position = History.GetPosition(Read, Slot);
+					if (FVector::Dist(Position, ExpectedPosition) > Tolerance || Position.Y != ExpectedPosition.Y)
+					{
+						if (NumMismatches++ == 0)
+						{
+							AddError(FString::Printf(TEXT("%s history read slot %d at frame %lld as %s instead of %s, after recording frame %d."),
+								bQuantized ? TEXT("Quantized") : TEXT("Full"), Slot, Read, *Position.ToString(), *ExpectedPosition.ToString(), Frame));
+						}
+					}
+				}
+			}
+		}
+		TestEqual(TEXT("Every read matches the dense copy"), NumMismatches, 0);
+		//Still slots only cost their bit, so the stored entries are far fewer than a dense history would hold.
+		TestTrue(TEXT("Still slots don't store entries"), History.NumEntries() < History.NumFrames() * NumSlots / 2);
+	}
+	return true;
+}
+
+#endif
\ No newline at end of file
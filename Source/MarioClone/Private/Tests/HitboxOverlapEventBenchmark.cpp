@@ -0,0 +1,74 @@
+﻿#include "HitboxManager.h"
+#include "HitboxStressTest.h"
+#include "MarioTestWorld.h"
+#include "Misc/AutomationTest.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHitboxOverlapEventBenchmark, "MarioClone.Hitboxes.Benchmarks.OverlapEvents",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Runs a hitbox storm on physics overlaps, once with a single channel that every hitbox overlaps and once with a channel per hostility,
+//and counts the overlap events physics reports per frame. Half of the storm's hitboxes share each hostility, so per-hostility channels should
+//remove roughly half of the events without changing the contacts that get resolved.
+bool FHitboxOverlapEventBenchmark::RunTest(const FString& Parameters)
+{
+	static constexpr int32 NumHitboxes = 500;
+	static constexpr int32 WarmupFrames = 30;
+	static constexpr int32 MeasuredFrames = 120;
+	FScopedConsoleVariableOverride UseBroadphase(TEXT("Hitboxes.UseBroadphase"));
+	FScopedConsoleVariableOverride UseHostilityProfiles(TEXT("Hitboxes.UseHostilityProfiles"));
+	if (!TestTrue(TEXT("Hitboxes.UseBroadphase exists"), UseBroadphase.IsValid()) || !TestTrue(TEXT("Hitboxes.UseHostilityProfiles exists"), UseHostilityProfiles.IsValid()))
+	{
+		return false;
+	}
+	//Overlap events only come from physics.
+	UseBroadphase.Set(false);
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Profiles,OverlapEventsPerFrame,ContactsPerFrame,WorldTickMs"));
+	double EventsPerFrame[2] = { 0.0, 0.0 };
+	double ContactsPerFrame[2] = { 0.0, 0.0 };
+	for (const bool bHostilityProfiles : { false, true })
+	{
+		UseHostilityProfiles.Set(bHostilityProfiles);
+		FMarioTestWorld TestWorld;
+		UHitboxStressTest* StressTest = TestWorld.GetWorld()->GetSubsystem<UHitboxStressTest>();
+		const UHitboxManager* HitboxManager = TestWorld.GetWorld()->GetSubsystem<UHitboxManager>();
+		if (!TestNotNull(TEXT("Stress test subsystem exists"), StressTest) || !TestNotNull(TEXT("Hitbox manager exists"), HitboxManager))
+		{
+			continue;
+		}
+		StressTest->StartStressTest(NumHitboxes, WarmupFrames + MeasuredFrames, true);
+		TestWorld.TickFrames(WarmupFrames, FMarioTestWorld::FrameTime);
+		double WorldTickSeconds = 0.0;
+		int64 NumOverlapEvents = 0;
+		int64 NumContacts = 0;
+		for (int32 Frame = 0; Frame < MeasuredFrames; Frame++)
+		{
+			{
+				FSimpleScopeSecondsCounter TickTimer(WorldTickSeconds);
+				TestWorld.Tick(FMarioTestWorld::FrameTime);
+			}
+			NumOverlapEvents += HitboxManager->GetLastFrameTimings().NumOverlapEvents;
+			NumContacts += HitboxManager->GetLastFrameTimings().NumContacts;
+		}
+		const int32 Run = bHostilityProfiles ? 1 : 0;
+		EventsPerFrame[Run] = static_cast<double>(NumOverlapEvents) / MeasuredFrames;
+		ContactsPerFrame[Run] = static_cast<double>(NumContacts) / MeasuredFrames;
+		const TCHAR* Profiles = bHostilityProfiles ? TEXT("PerHostility") : TEXT("Single");
+		const double WorldTickMs = WorldTickSeconds / MeasuredFrames * 1000.0;
+		AddInfo(FString::Printf(TEXT("%s channel setup: %.1f overlap events and %.1f contacts per frame, %.3f ms per world tick"),
+			Profiles, EventsPerFrame[Run], ContactsPerFrame[Run], WorldTickMs));
+		CsvLines.Add(FString::Printf(TEXT("%s,%.1f,%.1f,%.3f"), Profiles, EventsPerFrame[Run], ContactsPerFrame[Run], WorldTickMs));
+	}
+	TestTrue(TEXT("Per-hostility channels report fewer overlap events"), EventsPerFrame[1] < EventsPerFrame[0]);
+	if (EventsPerFrame[0] > 0.0)
+	{
+		AddInfo(FString::Printf(TEXT("Per-hostility channels removed %.1f%% of overlap events."), (1.0 - EventsPerFrame[1] / EventsPerFrame[0]) * 100.0));
+	}
+	WriteBenchmarkCsv(*this, TEXT("HitboxOverlapEvents"), CsvLines);
+	return true;
+}
+
+#endif
\ No newline at end of file
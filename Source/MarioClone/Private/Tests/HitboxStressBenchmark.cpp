@@ -0,0 +1,73 @@
+﻿#include "HitboxManager.h"
+#include "HitboxStressTest.h"
+#include "MarioTestWorld.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHitboxStressBenchmark, "MarioClone.Hitboxes.Benchmarks.StressTest",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Runs the hitbox stress test to completion in a fresh world, spread out and as a storm, and reports the manager's time and memory on each path.
+//This runs headless, for example:
+//UnrealEditor-Cmd MarioClone.uproject -nullrhi -unattended -llm -ExecCmds="Automation RunTests MarioClone.Hitboxes.Benchmarks.StressTest; Quit"
+//Without -llm the per-path memory is reported as zero, and only the manager's own container capacity is measured.
+bool FHitboxStressBenchmark::RunTest(const FString& Parameters)
+{
+	static constexpr int32 NumHitboxes = 1000;
+	static constexpr int32 NumFrames = 300;
+	//The manager's containers settle after the first few seconds, so memory that still grows after this is allocated every frame.
+	static constexpr int32 WarmupFrames = 120;
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if (!FLowLevelMemTracker::IsEnabled())
+#endif
+	{
+		AddInfo(TEXT("The low level memory tracker is off, so per-path memory isn't measured. Run with -llm to measure it."));
+	}
+	for (const bool bStorm : { false, true })
+	{
+		FMarioTestWorld TestWorld;
+		UHitboxStressTest* StressTest = TestWorld.GetWorld()->GetSubsystem<UHitboxStressTest>();
+		const UHitboxManager* HitboxManager = TestWorld.GetWorld()->GetSubsystem<UHitboxManager>();
+		if (!TestNotNull(TEXT("Stress test subsystem exists"), StressTest) || !TestNotNull(TEXT("Hitbox manager exists"), HitboxManager))
+		{
+			continue;
+		}
+		StressTest->StartStressTest(NumHitboxes, NumFrames, bStorm);
+		FHitboxFrameTimings Total;
+		FHitboxFrameTimings Warm;
+		int32 Frame = 0;
+		//A few frames of headroom, in case the stress test and the manager tick in either order.
+		for (; Frame < NumFrames + 2 && StressTest->IsRunning(); Frame++)
+		{
+			TestWorld.Tick(FMarioTestWorld::FrameTime);
+			const FHitboxFrameTimings& Timings = HitboxManager->GetLastFrameTimings();
+			Total.Register += Timings.Register;
+			Total.Broadphase += Timings.Broadphase;
+			Total.Rewind += Timings.Rewind;
+			Total.Validate += Timings.Validate;
+			Total.NumValidations += Timings.NumValidations;
+			if (Frame == WarmupFrames)
+			{
+				Warm = Timings;
+			}
+		}
+		TestFalse(TEXT("Stress test finished"), StressTest->IsRunning());
+		TestTrue(TEXT("Stress test validated collisions"), Total.NumValidations > 0);
+		TestFalse(TEXT("Stress test wrote its results"), StressTest->GetResultsPath().IsEmpty());
+		const FHitboxFrameTimings& Last = HitboxManager->GetLastFrameTimings();
+		const TCHAR* Layout = bStorm ? TEXT("storm") : TEXT("grid");
+		AddInfo(FString::Printf(TEXT("%d hitboxes in a %s over %d frames: %.3f ms registering, %.3f ms per frame in the broadphase, %.3f ms rewinding, %.3f ms validating."),
+			NumHitboxes, Layout, Frame, Total.Register * 1000.0, Total.Broadphase * 1000.0 / Frame, Total.Rewind * 1000.0 / Frame, Total.Validate * 1000.0 / Frame));
+		AddInfo(FString::Printf(TEXT("Tracked bytes at the end of the %s run, and growth since frame %d: register %lld (%+lld), broadphase %lld (%+lld), rewind %lld (%+lld), validate %lld (%+lld)."),
+			Layout, WarmupFrames, Last.RegisterTrackedBytes, Last.RegisterTrackedBytes - Warm.RegisterTrackedBytes,
+			Last.BroadphaseTrackedBytes, Last.BroadphaseTrackedBytes - Warm.BroadphaseTrackedBytes,
+			Last.RewindTrackedBytes, Last.RewindTrackedBytes - Warm.RewindTrackedBytes,
+			Last.ValidateTrackedBytes, Last.ValidateTrackedBytes - Warm.ValidateTrackedBytes));
+		AddInfo(FString::Printf(TEXT("Per-frame results written to %s."), *StressTest->GetResultsPath()));
+	}
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+﻿#include "HitboxManager.h"
+#include "MarioMovementComponent.h"
+#include "MarioMovementTestAccess.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/CoreNet.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioMoveDataRoundTripTest, "MarioClone.Movement.MoveDataRoundTrip",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+namespace MarioMoveDataTests
+{
+	using FMoveData = FMarioMovementTestAccess::FMoveData;
+
+	//Moves an owning client sends every second, each with one new move.
+	static constexpr int32 MovesPerSecond = 60;
+
+	struct FMoveDataCase
+	{
+		const TCHAR* Name;
+		FMarioCollisionEvents Events;
+		//Bits the collisions should take on top of the base move data.
+		int64 ExpectedBits;
+	};
+
+	FMarioCollisionEvent MakeEvent(const uint16 Sequence, const int32 ThisHitboxID, const int32 OtherHitboxID, const double CollisionTime)
+	{
+		FMarioCollisionEvent Event;
+		Event.Sequence = Sequence;
+		Event.ThisHitboxID = ThisHitboxID;
+		Event.OtherHitboxID = OtherHitboxID;
+		Event.Outcome.bBouncedThis = true;
+		Event.Outcome.bDamagedOther = true;
+		Event.CollisionTime = CollisionTime;
+		return Event;
+	}
+
+	int64 WriteMoveData(FMoveData& MoveData, FNetBitWriter& Writer)
+	{
+		MoveData.Serialize(*GetMutableDefault<UMarioMovementComponent>(), Writer, nullptr, ENetworkMoveType::NewMove);
+		return Writer.GetNumBits();
+	}
+}
+
+//Writes move data with each kind of collision queue through the same bit writer and reader the character movement RPCs use,
+//and checks that every event reads back the same and costs the bits the encoding is meant to.
+bool FMarioMoveDataRoundTripTest::RunTest(const FString& Parameters)
+{
+	using namespace MarioMoveDataTests;
+	//The flag, a two bit count of the extra events, and the first event's sequence.
+	static constexpr int64 QueueBits = 1 + 2 + 16;
+	//Outcome bits, a slot index and generation under 128 that take a byte each, and a collision time with its presence bit.
+	static constexpr int64 SmallEventBits = 4 + 2 * (8 + 8) + 65;
+	const int32 SmallID = UHitboxManager::MakeHitboxID(3, 1);
+	const int32 OtherSmallID = UHitboxManager::MakeHitboxID(117, 5);
+	const int32 MaxID = UHitboxManager::MakeHitboxID(UHitboxManager::HitboxIndexMask, UHitboxManager::HitboxGenerationMask);
+
+	TArray<FMoveDataCase> Cases;
+	Cases.Add({ TEXT("No collision"), FMarioCollisionEvents(), 1 });
+	FMoveDataCase& OneEvent = Cases.Add_GetRef({ TEXT("One event"), FMarioCollisionEvents(), QueueBits + SmallEventBits });
+	OneEvent.Events.Add(MakeEvent(12, SmallID, OtherSmallID, 25.5));
+	//Sequences wrap around partway through the queue.
+	FMoveDataCase& FullQueue = Cases.Add_GetRef({ TEXT("Four events"), FMarioCollisionEvents(), QueueBits + FMarioCollisionEvents::Capacity * SmallEventBits });
+	for (int32 EventIndex = 0; EventIndex < FMarioCollisionEvents::Capacity; EventIndex++)
+	{
+		FullQueue.Events.Add(MakeEvent(static_cast<uint16>(MAX_uint16 - 1 + EventIndex), SmallID, OtherSmallID + EventIndex, 25.5 + EventIndex));
+	}
+	//No hitbox is a single zero byte, and the generation is left out. An unknown time is only its presence bit.
+	FMoveDataCase& NoHitboxes = Cases.Add_GetRef({ TEXT("No hitboxes"), FMarioCollisionEvents(), QueueBits + 4 + 8 + 8 + 1 });
+	NoHitboxes.Events.Add(MakeEvent(0, -1, -1, -1.0));
+	//The largest index is sent as 1 << 20, which takes three seven bit groups, and the largest generation takes two.
+	FMoveDataCase& MaxHitboxes = Cases.Add_GetRef({ TEXT("Largest hitbox IDs"), FMarioCollisionEvents(), QueueBits + 4 + 2 * (24 + 16) + 65 });
+	MaxHitboxes.Events.Add(MakeEvent(MAX_uint16, MaxID, MaxID, 25.5));
+
+	FMoveData BaseMoveData;
+	FNetBitWriter BaseWriter(nullptr, 1024);
+	const int64 BaseBits = WriteMoveData(BaseMoveData, BaseWriter);
+	for (FMoveDataCase& Case : Cases)
+	{
+		FMoveData Sent;
+		Sent.CollisionEvents = Case.Events;
+		FNetBitWriter Writer(nullptr, 1024);
+		const int64 CollisionBits = WriteMoveData(Sent, Writer) - BaseBits;
+		if (!TestFalse(FString::Printf(TEXT("%s writes without errors"), Case.Name), Writer.IsError()))
+		{
+			continue;
+		}
+		TestEqual(FString::Printf(TEXT("%s costs the expected bits"), Case.Name), CollisionBits, Case.ExpectedBits);
+
+		FNetBitReader Reader(nullptr, Writer.GetData(), Writer.GetNumBits());
+		FMoveData Received;
+		//Stale events from an earlier move must not survive reading a move without any.
+		Received.CollisionEvents.Add(MakeEvent(1, SmallID, SmallID, 1.0));
+		Received.Serialize(*GetMutableDefault<UMarioMovementComponent>(), Reader, nullptr, ENetworkMoveType::NewMove);
+		TestFalse(FString::Printf(TEXT("%s reads without errors"), Case.Name), Reader.IsError());
+		TestEqual(FString::Printf(TEXT("%s reads every bit it wrote"), Case.Name), Reader.GetPosBits(), Writer.GetNumBits());
+		if (!TestEqual(FString::Printf(TEXT("%s reads back the same number of events"), Case.Name), Received.CollisionEvents.Num, Case.Events.Num))
+		{
+			continue;
+		}
+		for (int32 EventIndex = 0; EventIndex < Case.Events.Num; EventIndex++)
+		{
+			const FMarioCollisionEvent& Expected = Case.Events.Events[EventIndex];
+			const FMarioCollisionEvent& Actual = Received.CollisionEvents.Events[EventIndex];
+			const FString What = FString::Printf(TEXT("%s event %d"), Case.Name, EventIndex);
+			TestEqual(What + TEXT(" sequence"), Actual.Sequence, Expected.Sequence);
+			TestEqual(What + TEXT(" this hitbox"), Actual.ThisHitboxID, Expected.ThisHitboxID);
+			TestEqual(What + TEXT(" other hitbox"), Actual.OtherHitboxID, Expected.OtherHitboxID);
+			TestEqual(What + TEXT(" collision time"), Actual.CollisionTime, Expected.CollisionTime);
+			TestTrue(What + TEXT(" outcome"), Actual.Outcome.bBouncedThis == Expected.Outcome.bBouncedThis && Actual.Outcome.bBouncedOther == Expected.Outcome.bBouncedOther
+				&& Actual.Outcome.bDamagedThis == Expected.Outcome.bDamagedThis && Actual.Outcome.bDamagedOther == Expected.Outcome.bDamagedOther);
+		}
+		//Upstream cost for a client that sent this in every move, against the encoding with a whole field per value.
+		const int32 UnpackedBits = FMarioMovementTestAccess::GetUnpackedBits(Sent);
+		AddInfo(FString::Printf(TEXT("%s: %lld bits, %.1f bytes/s at %d moves per second, was %d bits, %.1f bytes/s."), Case.Name,
+			CollisionBits, CollisionBits * MovesPerSecond / 8.0, MovesPerSecond, UnpackedBits, UnpackedBits * MovesPerSecond / 8.0));
+	}
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+﻿#include "MarioMovementComponent.h"
+#include "MarioMovementSettings.h"
+#include "MarioPlayerCharacter.h"
+#include "MarioTestWorld.h"
+#include "TileCollisionManager.h"
+#include "Misc/AutomationTest.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace MarioMovementBenchmark
+{
+	static constexpr float FloorTop = 0.0f;
+	static constexpr float WallSpacing = 1200.0f;
+	static constexpr float CharacterSpacing = 300.0f;
+
+	//A long floor with low walls along it, which the characters run into and jump over.
+	void BuildLevel(UWorld& World, const float Length)
+	{
+		AddStaticBlock(World, FVector(Length * 0.5f, 0.0f, FloorTop - 50.0f), FVector(Length * 0.5f + 1000.0f, 500.0f, 50.0f));
+		for (float X = WallSpacing * 0.5f; X < Length; X += WallSpacing)
+		{
+			AddStaticBlock(World, FVector(X, 0.0f, FloorTop + 40.0f), FVector(50.0f, 500.0f, 40.0f));
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioMovementTileBenchmark, "MarioClone.Movement.Benchmarks.TileVsPhysics",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Runs crowds of Mario characters back and forth over the same level with tile collision and with physics queries, and compares the cost per character.
+//Characters are close enough to run into each other, so the tile path's physics sweep for pawns is part of what is measured.
+bool FMarioMovementTileBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace MarioMovementBenchmark;
+	static constexpr int32 WarmupFrames = 30;
+	static constexpr int32 MeasuredFrames = 240;
+	//Frames each character runs one way before turning around.
+	static constexpr int32 FramesPerRun = 90;
+	TGuardValue<bool> UseTileCollision(GetMutableDefault<UMarioMovementSettings>()->bUseTileCollision, false);
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Characters,Collision,WorldTickMs,UsPerCharacter,Fallen"));
+	for (const int32 NumCharacters : { 50, 250 })
+	{
+		for (const bool bTiles : { false, true })
+		{
+			GetMutableDefault<UMarioMovementSettings>()->bUseTileCollision = bTiles;
+			const float Length = NumCharacters * CharacterSpacing;
+			FMarioTestWorld TestWorld([Length](UWorld& World) { BuildLevel(World, Length); });
+			const UTileCollisionManager* TileCollisionManager = TestWorld.GetWorld()->GetSubsystem<UTileCollisionManager>();
+			if (!TestNotNull(TEXT("Tile collision manager exists"), TileCollisionManager))
+			{
+				continue;
+			}
+			TestEqual(TEXT("World uses the requested collision"), TileCollisionManager->IsUsingTileCollision(), bTiles);
+			TArray<AMarioPlayerCharacter*> Characters;
+			for (int32 Index = 0; Index < NumCharacters; Index++)
+			{
+				FActorSpawnParameters SpawnParams;
+				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+				AMarioPlayerCharacter* Character = TestWorld.GetWorld()->SpawnActor<AMarioPlayerCharacter>(FVector(Index * CharacterSpacing, 0.0f, FloorTop + 200.0f),
+					FRotator::ZeroRotator, SpawnParams);
+				if (IsValid(Character))
+				{
+					//Nobody controls these characters, so the server runs their movement.
+					Character->GetCharacterMovement()->bRunPhysicsWithNoController = true;
+					Characters.Add(Character);
+				}
+			}
+			if (!TestEqual(TEXT("Every character spawned"), Characters.Num(), NumCharacters))
+			{
+				continue;
+			}
+			double WorldTickSeconds = 0.0;
+			for (int32 Frame = 0; Frame < WarmupFrames + MeasuredFrames; Frame++)
+			{
+				for (int32 Index = 0; Index < Characters.Num(); Index++)
+				{
+					//Neighbors start out running towards each other.
+					const bool bRight = ((Frame / FramesPerRun) + Index) % 2 == 0;
+					Characters[Index]->AddMovementInput(FVector(bRight ? 1.0f : -1.0f, 0.0f, 0.0f));
+					if ((Frame + Index) % 45 == 0)
+					{
+						Characters[Index]->Jump();
+					}
+					else
+					{
+						Characters[Index]->StopJumping();
+					}
+				}
+				if (Frame < WarmupFrames)
+				{
+					TestWorld.Tick(FMarioTestWorld::FrameTime);
+					continue;
+				}
+				FSimpleScopeSecondsCounter TickTimer(WorldTickSeconds);
+				TestWorld.Tick(FMarioTestWorld::FrameTime);
+			}
+			//Both kinds of collision should keep everyone on top of the floor.
+			int32 NumFallen = 0;
+			for (const AMarioPlayerCharacter* Character : Characters)
+			{
+				NumFallen += Character->GetActorLocation().Z < FloorTop ? 1 : 0;
+			}
+			TestEqual(TEXT("No character fell through the floor"), NumFallen, 0);
+			const TCHAR* Collision = bTiles ? TEXT("Tiles") : TEXT("Physics");
+			const double WorldTickMs = WorldTickSeconds / MeasuredFrames * 1000.0;
+			const double UsPerCharacter = WorldTickSeconds / MeasuredFrames / NumCharacters * 1000000.0;
+			AddInfo(FString::Printf(TEXT("%d characters, %s: %.3f ms per world tick, %.2f us per character"), NumCharacters, Collision, WorldTickMs, UsPerCharacter));
+			CsvLines.Add(FString::Printf(TEXT("%d,%s,%.3f,%.2f,%d"), NumCharacters, Collision, WorldTickMs, UsPerCharacter, NumFallen));
+		}
+	}
+	WriteBenchmarkCsv(*this, TEXT("MarioMovementBenchmark"), CsvLines);
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,257 @@
+﻿#include "Hitbox.h"
+#include "HitboxStressActor.h"
+#include "MarioMovementComponent.h"
+#include "MarioMovementSettings.h"
+#include "MarioMovementTestAccess.h"
+#include "MarioPlayerCharacter.h"
+#include "MarioTestWorld.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioMovementSimulationTest, "MarioClone.Movement.Simulation",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+namespace MarioMovementSimulationTests
+{
+	//Comma separated steps. R, L, or I followed by a frame count holds right, left, or nothing for that many frames.
+	//J jumps and B bounces on the first frame of the next step.
+	static const TCHAR* Script = TEXT("R30,J,R45,I20,B,I40,L60,J,L30,I60");
+	//The script can be run several times over for a longer run to measure, with -MovementSimulationRepeat=, up to this many times.
+	static constexpr int32 MaxRepeats = 100;
+	static constexpr float FloorTop = 0.0f;
+	//Positions further apart than this from the expected trajectory count as a divergence.
+	static constexpr float DivergenceTolerance = 0.01f;
+	//Far away from the level so that nothing touches it. It only exists to give injected bounces a real hitbox to bounce off.
+	static constexpr float BounceSourceZ = -100000.0f;
+
+	//One frame of input.
+	struct FSimulationInput
+	{
+		float MovementAxis = 0.0f;
+		bool bJump = false;
+		//Queued as a collision before the move, as if the player had stomped something.
+		bool bBounce = false;
+	};
+
+	//One frame of a recorded trajectory.
+	struct FSimulationSample
+	{
+		FVector Location = FVector::ZeroVector;
+		FVector Velocity = FVector::ZeroVector;
+		uint8 MovementMode = 0;
+	};
+
+	bool ParseScript(const FString& InScript, TArray<FSimulationInput>& OutInputs)
+	{
+		TArray<FString> Steps;
+		InScript.ParseIntoArray(Steps, TEXT(","));
+		bool bJumpNext = false;
+		bool bBounceNext = false;
+		for (const FString& RawStep : Steps)
+		{
+			const FString Step = RawStep.TrimStartAndEnd().ToUpper();
+			if (Step.IsEmpty())
+			{
+				continue;
+			}
+			if (Step == TEXT("J"))
+			{
+				bJumpNext = true;
+				continue;
+			}
+			if (Step == TEXT("B"))
+			{
+				bBounceNext = true;
+				continue;
+			}
+			const FString FrameCount = Step.RightChop(1);
+			const float MovementAxis = Step[0] == TEXT('R') ? 1.0f : Step[0] == TEXT('L') ? -1.0f : 0.0f;
+			if ((Step[0] != TEXT('R') && Step[0] != TEXT('L') && Step[0] != TEXT('I')) || FrameCount.IsEmpty() || !FrameCount.IsNumeric())
+			{
+				return false;
+			}
+			const int32 NumFrames = FCString::Atoi(*FrameCount);
+			for (int32 Frame = 0; Frame < NumFrames; Frame++)
+			{
+				FSimulationInput& Input = OutInputs.AddDefaulted_GetRef();
+				Input.MovementAxis = MovementAxis;
+				Input.bJump = bJumpNext;
+				Input.bBounce = bBounceNext;
+				bJumpNext = false;
+				bBounceNext = false;
+			}
+		}
+		return OutInputs.Num() > 0;
+	}
+
+	//Runs a player character through the inputs on a floor in a world of its own, and returns how long the moves took.
+	//The movement component is ticked directly, so nothing else in the world moves and runs are repeatable.
+	double RunSimulation(FAutomationTestBase& Test, const TArray<FSimulationInput>& Inputs, TArray<FSimulationSample>& OutSamples)
+	{
+		FMarioTestWorld TestWorld([](UWorld& World) { AddStaticBlock(World, FVector(0.0f, 0.0f, FloorTop - 50.0f), FVector(10000.0f, 500.0f, 50.0f)); });
+		UWorld* World = TestWorld.GetWorld();
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		AMarioPlayerCharacter* Character = World->SpawnActor<AMarioPlayerCharacter>(FVector(0.0f, 0.0f, FloorTop + 200.0f), FRotator::ZeroRotator, SpawnParams);
+		UMarioMovementComponent* MoveComponent = IsValid(Character) ? Cast<UMarioMovementComponent>(Character->GetCharacterMovement()) : nullptr;
+		APlayerController* Controller = World->SpawnActor<APlayerController>();
+		const UHitbox* CharacterHitbox = IsValid(Character) ? Character->FindComponentByClass<UHitbox>() : nullptr;
+		const FTransform BounceSourceTransform(FVector(0.0f, 0.0f, BounceSourceZ));
+		AHitboxStressActor* BounceSource = World->SpawnActorDeferred<AHitboxStressActor>(AHitboxStressActor::StaticClass(), BounceSourceTransform,
+			nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if (IsValid(BounceSource))
+		{
+			BounceSource->InitStressMotion(EHostility::Enemy, BounceSourceTransform.GetLocation(), FVector::ZeroVector, 1.0f, 0.0f);
+			BounceSource->FinishSpawning(BounceSourceTransform);
+		}
+		if (!Test.TestNotNull(TEXT("Character uses the Mario movement component"), MoveComponent) || !Test.TestNotNull(TEXT("Controller spawned"), Controller)
+			|| !Test.TestNotNull(TEXT("Character has a hitbox"), CharacterHitbox) || !Test.TestNotNull(TEXT("Bounce source spawned"), BounceSource))
+		{
+			return 0.0;
+		}
+		//Possessed like the player in a standalone game, so the character predicts its own collisions and bounces during the move.
+		Controller->Possess(Character);
+
+		FHitboxCollisionOutcome Bounce;
+		Bounce.bBouncedThis = true;
+		OutSamples.Reset(Inputs.Num());
+		const double StartTime = FPlatformTime::Seconds();
+		for (const FSimulationInput& Input : Inputs)
+		{
+			if (Input.bBounce)
+			{
+				FMarioMovementTestAccess::AddCollisionEvent(*MoveComponent, CharacterHitbox->GetHitboxID(), BounceSource->GetHitbox()->GetHitboxID(), Bounce);
+			}
+			Character->MovementInput(Input.MovementAxis);
+			if (Input.bJump)
+			{
+				Character->JumpPressed();
+			}
+			MoveComponent->TickComponent(FMarioTestWorld::FrameTime, LEVELTICK_All, nullptr);
+			FSimulationSample& Sample = OutSamples.AddDefaulted_GetRef();
+			Sample.Location = Character->GetActorLocation();
+			Sample.Velocity = MoveComponent->Velocity;
+			Sample.MovementMode = MoveComponent->MovementMode;
+		}
+		return FPlatformTime::Seconds() - StartTime;
+	}
+
+	TArray<FString> MakeTrajectoryCsv(const TArray<FSimulationSample>& Samples, const int32 NumFrames)
+	{
+		TArray<FString> Lines;
+		Lines.Reserve(NumFrames + 1);
+		Lines.Add(TEXT("Frame,Time,X,Z,VelocityX,VelocityZ,MovementMode"));
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			const FSimulationSample& Sample = Samples[Frame];
+			Lines.Add(FString::Printf(TEXT("%d,%.4f,%.4f,%.4f,%.4f,%.4f,%d"), Frame, (Frame + 1) * FMarioTestWorld::FrameTime,
+				Sample.Location.X, Sample.Location.Z, Sample.Velocity.X, Sample.Velocity.Z, Sample.MovementMode));
+		}
+		return Lines;
+	}
+
+	//The trajectory of one run of the script, checked in next to this test.
+	FString GetExpectedTrajectoryPath()
+	{
+		return FPaths::Combine(FPaths::GameSourceDir(), TEXT("MarioClone/Private/Tests/MarioMovementSimulationTrajectory.csv"));
+	}
+}
+
+//Runs a scripted sequence of running, jumping, and a bounce twice, and checks that both runs follow the same trajectory
+//and that it matches the trajectory checked in from an earlier build. Any change to movement that moves the character shows up here
+//as the first frame where the trajectories diverge, and the expected trajectory is then re-recorded if the change was intended.
+bool FMarioMovementSimulationTest::RunTest(const FString& Parameters)
+{
+	using namespace MarioMovementSimulationTests;
+	int32 Repeat = 1;
+	FParse::Value(FCommandLine::Get(), TEXT("MovementSimulationRepeat="), Repeat);
+	if (Repeat < 1 || Repeat > MaxRepeats)
+	{
+		AddWarning(FString::Printf(TEXT("The script can be repeated from 1 to %d times, so %d is clamped."), MaxRepeats, Repeat));
+		Repeat = FMath::Clamp(Repeat, 1, MaxRepeats);
+	}
+	TArray<FSimulationInput> ScriptInputs;
+	if (!TestTrue(TEXT("Script parses"), ParseScript(Script, ScriptInputs)))
+	{
+		return false;
+	}
+	TArray<FSimulationInput> Inputs;
+	Inputs.Reserve(ScriptInputs.Num() * Repeat);
+	for (int32 Run = 0; Run < Repeat; Run++)
+	{
+		Inputs.Append(ScriptInputs);
+	}
+	//The expected trajectory is recorded with physics queries, which every build has.
+	TGuardValue<bool> UseTileCollision(GetMutableDefault<UMarioMovementSettings>()->bUseTileCollision, false);
+
+	TArray<FSimulationSample> Samples;
+	TArray<FSimulationSample> RepeatedSamples;
+	RunSimulation(*this, Inputs, Samples);
+	const double ElapsedSeconds = RunSimulation(*this, Inputs, RepeatedSamples);
+	if (!TestEqual(TEXT("Both runs simulate every frame"), Samples.Num(), Inputs.Num()) || !TestEqual(TEXT("The repeated run simulates every frame"), RepeatedSamples.Num(), Inputs.Num()))
+	{
+		return false;
+	}
+	AddInfo(FString::Printf(TEXT("Simulated %d moves in %.3f ms (%.0f moves per second)."), RepeatedSamples.Num(), ElapsedSeconds * 1000.0,
+		ElapsedSeconds > 0.0 ? RepeatedSamples.Num() / ElapsedSeconds : 0.0));
+	WriteBenchmarkCsv(*this, TEXT("MovementSimulation"), MakeTrajectoryCsv(Samples, Samples.Num()));
+
+	for (int32 Frame = 0; Frame < Samples.Num(); Frame++)
+	{
+		const FSimulationSample& First = Samples[Frame];
+		const FSimulationSample& Second = RepeatedSamples[Frame];
+		if (First.Location != Second.Location || First.Velocity != Second.Velocity || First.MovementMode != Second.MovementMode)
+		{
+			AddError(FString::Printf(TEXT("Runs diverged at frame %d: (%.4f, %.4f) and (%.4f, %.4f)."),
+				Frame, First.Location.X, First.Location.Z, Second.Location.X, Second.Location.Z));
+			break;
+		}
+	}
+
+	const FString ExpectedPath = GetExpectedTrajectoryPath();
+	TArray<FString> ExpectedLines;
+	if (!FFileHelper::LoadFileToStringArray(ExpectedLines, *ExpectedPath))
+	{
+		//Record this run so the trajectory can be checked in, and later builds are compared against it.
+		if (FFileHelper::SaveStringArrayToFile(MakeTrajectoryCsv(Samples, ScriptInputs.Num()), *ExpectedPath))
+		{
+			AddWarning(FString::Printf(TEXT("No expected trajectory was found, so this run's was recorded to %s. Check it in to compare later builds against it."), *ExpectedPath));
+		}
+		else
+		{
+			AddError(FString::Printf(TEXT("No expected trajectory was found at %s, and this run's couldn't be recorded there."), *ExpectedPath));
+		}
+		return true;
+	}
+	//The first line is the header.
+	if (!TestEqual(TEXT("Expected trajectory covers one run of the script"), ExpectedLines.Num() - 1, ScriptInputs.Num()))
+	{
+		return true;
+	}
+	for (int32 Frame = 0; Frame < ScriptInputs.Num(); Frame++)
+	{
+		TArray<FString> Fields;
+		ExpectedLines[Frame + 1].ParseIntoArray(Fields, TEXT(","));
+		if (!TestTrue(FString::Printf(TEXT("Expected trajectory has a whole line for frame %d"), Frame), Fields.Num() >= 4))
+		{
+			break;
+		}
+		const FVector2D Expected(FCString::Atod(*Fields[2]), FCString::Atod(*Fields[3]));
+		const FVector2D Location(Samples[Frame].Location.X, Samples[Frame].Location.Z);
+		if (FMath::Abs(Location.X - Expected.X) > DivergenceTolerance || FMath::Abs(Location.Y - Expected.Y) > DivergenceTolerance)
+		{
+			AddError(FString::Printf(TEXT("Trajectory diverged from %s at frame %d: (%.4f, %.4f) instead of (%.4f, %.4f)."),
+				*ExpectedPath, Frame, Location.X, Location.Y, Expected.X, Expected.Y));
+			break;
+		}
+	}
+	return true;
+}
+
+#endif
\ No newline at end of file
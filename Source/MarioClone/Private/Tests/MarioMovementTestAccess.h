@@ -0,0 +1,30 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "MarioMovementComponent.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//Lets the automation tests reach the movement component's private move types and collision state.
+struct FMarioMovementTestAccess
+{
+	using FMoveData = UMarioMovementComponent::FMarioNetworkMoveData;
+	using FSavedMove = UMarioMovementComponent::FSavedMove_Mario;
+
+	//Bits the same move data would have cost before collisions were bit-packed.
+	static int32 GetUnpackedBits(const FMoveData& MoveData) { return MoveData.GetUnpackedBits(); }
+	//Queues a collision the way a hitbox contact does on the client predicting it.
+	static void AddCollisionEvent(UMarioMovementComponent& Movement, const int32 ThisID, const int32 OtherID, const FHitboxCollisionOutcome& Outcome)
+	{
+		Movement.AddCollisionEvent(ThisID, OtherID, Outcome);
+	}
+	static const FMarioCollisionEvents& GetCollisionEvents(const UMarioMovementComponent& Movement) { return Movement.CollisionEvents; }
+	static const FMarioCollisionEvents& GetSavedCollisionEvents(const FSavedMovePtr& Move) { return static_cast<const FSavedMove*>(Move.Get())->SavedCollisionEvents; }
+	//Hands the component collisions the way the server receives them with a client's move, to be applied when the move runs.
+	static void ReceiveCollisionEvents(UMarioMovementComponent& Movement, const FMarioCollisionEvents& Events)
+	{
+		Movement.CollisionEvents = Events;
+		Movement.bWantsBounce = !Events.IsEmpty();
+	}
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,274 @@
+﻿#include "Hitbox.h"
+#include "HitboxManager.h"
+#include "HitboxStressActor.h"
+#include "MarioMovementComponent.h"
+#include "MarioMovementTestAccess.h"
+#include "MarioPlayerCharacter.h"
+#include "MarioTestWorld.h"
+#include "GameFramework/GameStateBase.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioSavedMovePoolTest, "MarioClone.Movement.SavedMovePool",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+//Saves moves the way an owning client does, with the server acknowledging each one a round trip later, and checks that the pool is only
+//filled by the first saved move and that no moves are allocated after that.
+bool FMarioSavedMovePoolTest::RunTest(const FString& Parameters)
+{
+	static constexpr int32 NumFrames = 600;
+	//Moves waiting for acknowledgement at a 400ms round trip.
+	static constexpr int32 PendingMoves = 24;
+	FMarioTestWorld TestWorld;
+	AMarioPlayerCharacter* Character = TestWorld.GetWorld()->SpawnActor<AMarioPlayerCharacter>();
+	if (!TestNotNull(TEXT("Character spawned"), Character))
+	{
+		return false;
+	}
+	UMarioMovementComponent* MoveComponent = Cast<UMarioMovementComponent>(Character->GetCharacterMovement());
+	if (!TestNotNull(TEXT("Character uses the Mario movement component"), MoveComponent))
+	{
+		return false;
+	}
+	//The server and simulated proxies create prediction data too, but never save moves.
+	FNetworkPredictionData_Client_Character* ClientData = MoveComponent->GetPredictionData_Client_Character();
+	TestEqual(TEXT("Creating prediction data doesn't allocate moves"), MoveComponent->GetNumAllocatedSavedMoves(), 0);
+
+	Character->SetRole(ROLE_AutonomousProxy);
+	int32 AllocatedAfterFirstMove = 0;
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		ClientData->CurrentTimeStamp += FMarioTestWorld::FrameTime;
+		const FSavedMovePtr Move = ClientData->CreateSavedMove(Character, FMarioTestWorld::FrameTime, FVector::ZeroVector);
+		if (!TestTrue(TEXT("Saved move created"), Move.IsValid()))
+		{
+			break;
+		}
+		ClientData->SavedMoves.Push(Move);
+		if (ClientData->SavedMoves.Num() > PendingMoves)
+		{
+			ClientData->FreeMove(ClientData->SavedMoves[0]);
+			ClientData->SavedMoves.RemoveAt(0, 1, false);
+		}
+		if (Frame == 0)
+		{
+			AllocatedAfterFirstMove = MoveComponent->GetNumAllocatedSavedMoves();
+		}
+	}
+	TestTrue(TEXT("The first saved move fills the pool"), AllocatedAfterFirstMove > PendingMoves);
+	TestEqual(TEXT("No moves are allocated after the first"), MoveComponent->GetNumAllocatedSavedMoves(), AllocatedAfterFirstMove);
+	Character->SetRole(ROLE_Authority);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioCollisionQueueTest, "MarioClone.Movement.CollisionQueue",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioCollisionDedupeTest, "MarioClone.Movement.CollisionDedupe",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMarioCombineMovesTest, "MarioClone.Movement.CombineMoves",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+namespace MarioSavedMoveTests
+{
+	//A player character with nobody controlling it, which the server treats like a remote client's character.
+	UMarioMovementComponent* SpawnCharacter(FAutomationTestBase& Test, UWorld& World, AMarioPlayerCharacter*& OutCharacter)
+	{
+		OutCharacter = World.SpawnActor<AMarioPlayerCharacter>();
+		if (!Test.TestNotNull(TEXT("Character spawned"), OutCharacter))
+		{
+			return nullptr;
+		}
+		UMarioMovementComponent* MoveComponent = Cast<UMarioMovementComponent>(OutCharacter->GetCharacterMovement());
+		Test.TestNotNull(TEXT("Character uses the Mario movement component"), MoveComponent);
+		return MoveComponent;
+	}
+
+	//An enemy hitbox far away from everything, for collisions to name as the other hitbox.
+	AHitboxStressActor* SpawnOtherHitbox(UWorld& World)
+	{
+		const FTransform Transform(FVector(0.0, 0.0, -100000.0));
+		AHitboxStressActor* Actor = World.SpawnActorDeferred<AHitboxStressActor>(AHitboxStressActor::StaticClass(), Transform,
+			nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if (IsValid(Actor))
+		{
+			Actor->InitStressMotion(EHostility::Enemy, Transform.GetLocation(), FVector::ZeroVector, 1.0f, 0.0f);
+			Actor->FinishSpawning(Transform);
+		}
+		return Actor;
+	}
+
+	FHitboxCollisionOutcome MakeStomp()
+	{
+		FHitboxCollisionOutcome Outcome;
+		Outcome.bDamagedOther = true;
+		return Outcome;
+	}
+
+	//Saves a move the way the owning client does before sending it, without running it.
+	FSavedMovePtr SaveMove(ACharacter& Character, FNetworkPredictionData_Client_Character& ClientData)
+	{
+		ClientData.CurrentTimeStamp += FMarioTestWorld::FrameTime;
+		const FSavedMovePtr Move = ClientData.CreateSavedMove(&Character, FMarioTestWorld::FrameTime, FVector::ZeroVector);
+		if (Move.IsValid())
+		{
+			Move->SetMoveFor(&Character, FMarioTestWorld::FrameTime, FVector::ZeroVector, ClientData);
+			Move->PostUpdate(&Character, FSavedMove_Character::PostUpdate_Record);
+		}
+		return Move;
+	}
+}
+
+//Several hitboxes touching the player in one frame each queue an event, all of them are saved with the next move, and the ones past the queue's capacity are dropped
+//without using up sequence numbers, so the events that are sent stay consecutive.
+bool FMarioCollisionQueueTest::RunTest(const FString& Parameters)
+{
+	using namespace MarioSavedMoveTests;
+	FMarioTestWorld TestWorld;
+	AMarioPlayerCharacter* Character = nullptr;
+	UMarioMovementComponent* MoveComponent = SpawnCharacter(*this, *TestWorld.GetWorld(), Character);
+	if (!MoveComponent)
+	{
+		return false;
+	}
+	FNetworkPredictionData_Client_Character* ClientData = MoveComponent->GetPredictionData_Client_Character();
+	Character->SetRole(ROLE_AutonomousProxy);
+
+	for (int32 OtherID = 0; OtherID < 2; OtherID++)
+	{
+		FMarioMovementTestAccess::AddCollisionEvent(*MoveComponent, 0, OtherID, MakeStomp());
+	}
+	const FSavedMovePtr TwoEventMove = SaveMove(*Character, *ClientData);
+	if (!TestTrue(TEXT("Saved move created"), TwoEventMove.IsValid()))
+	{
+		return false;
+	}
+	const FMarioCollisionEvents& Saved = FMarioMovementTestAccess::GetSavedCollisionEvents(TwoEventMove);
+	const uint16 FirstSequence = Saved.Events[0].Sequence;
+	if (TestEqual(TEXT("Both collisions in one frame are saved with the move"), Saved.Num, 2))
+	{
+		TestEqual(TEXT("The first collision is kept"), Saved.Events[0].OtherHitboxID, 0);
+		TestEqual(TEXT("The second collision is kept"), Saved.Events[1].OtherHitboxID, 1);
+		TestEqual(TEXT("The collisions have consecutive sequences"), static_cast<int32>(static_cast<uint16>(Saved.Events[1].Sequence - FirstSequence)), 1);
+	}
+	ClientData->FreeMove(TwoEventMove);
+
+	//The move ran and cleared the queue, so the next frame starts empty.
+	MoveComponent->UpdateCharacterStateBeforeMovement(FMarioTestWorld::FrameTime);
+	TestTrue(TEXT("Running the move empties the queue"), FMarioMovementTestAccess::GetCollisionEvents(*MoveComponent).IsEmpty());
+	for (int32 OtherID = 0; OtherID < FMarioCollisionEvents::Capacity + 2; OtherID++)
+	{
+		FMarioMovementTestAccess::AddCollisionEvent(*MoveComponent, 0, OtherID, MakeStomp());
+	}
+	const FMarioCollisionEvents& Full = FMarioMovementTestAccess::GetCollisionEvents(*MoveComponent);
+	TestEqual(TEXT("Collisions past the capacity are dropped"), Full.Num, FMarioCollisionEvents::Capacity);
+	TestEqual(TEXT("The first collisions are the ones kept"), Full.Events[FMarioCollisionEvents::Capacity - 1].OtherHitboxID, FMarioCollisionEvents::Capacity - 1);
+	MoveComponent->UpdateCharacterStateBeforeMovement(FMarioTestWorld::FrameTime);
+	FMarioMovementTestAccess::AddCollisionEvent(*MoveComponent, 0, 0, MakeStomp());
+	TestEqual(TEXT("Dropped collisions don't use up sequences"),
+		static_cast<int32>(static_cast<uint16>(FMarioMovementTestAccess::GetCollisionEvents(*MoveComponent).Events[0].Sequence - FirstSequence)),
+		2 + FMarioCollisionEvents::Capacity);
+	MoveComponent->UpdateCharacterStateBeforeMovement(FMarioTestWorld::FrameTime);
+	Character->SetRole(ROLE_Authority);
+	return true;
+}
+
+//Clients send moves again until the server acknowledges them, so the server sees the same events more than once.
+//Each event is validated only the first time it arrives, including across the wraparound of the sequence numbers.
+bool FMarioCollisionDedupeTest::RunTest(const FString& Parameters)
+{
+	using namespace MarioSavedMoveTests;
+	FMarioTestWorld TestWorld;
+	AMarioPlayerCharacter* Character = nullptr;
+	UMarioMovementComponent* MoveComponent = SpawnCharacter(*this, *TestWorld.GetWorld(), Character);
+	const AHitboxStressActor* Other = SpawnOtherHitbox(*TestWorld.GetWorld());
+	const UHitboxManager* HitboxManager = TestWorld.GetWorld()->GetSubsystem<UHitboxManager>();
+	const UHitbox* CharacterHitbox = IsValid(Character) ? Character->FindComponentByClass<UHitbox>() : nullptr;
+	if (!MoveComponent || !TestNotNull(TEXT("Other hitbox spawned"), Other) || !TestNotNull(TEXT("Hitbox manager exists"), HitboxManager)
+		|| !TestNotNull(TEXT("Character has a hitbox"), CharacterHitbox) || !TestTrue(TEXT("Character's hitbox is registered"), CharacterHitbox->GetHitboxID() != -1))
+	{
+		return false;
+	}
+	//Validation needs history to rewind into.
+	TestWorld.TickFrames(2, FMarioTestWorld::FrameTime);
+
+	//Each move names the sequence of its first event and how many it carries.
+	struct FReceivedMove
+	{
+		const TCHAR* Name;
+		uint16 FirstSequence;
+		int32 NumEvents;
+		int32 ExpectedValidations;
+	};
+	const FReceivedMove Moves[] =
+	{
+		{ TEXT("The first move's events are all new"), MAX_uint16 - 1, 2, 2 },
+		{ TEXT("A resent move is ignored"), MAX_uint16 - 1, 2, 0 },
+		{ TEXT("Only events past the last one applied are new, across the wraparound"), MAX_uint16, 3, 2 },
+		{ TEXT("A late resend from before the wraparound is ignored"), MAX_uint16 - 1, 1, 0 },
+		{ TEXT("Events after the wraparound keep counting up"), 2, 1, 1 },
+	};
+	for (const FReceivedMove& Move : Moves)
+	{
+		FMarioCollisionEvents Events;
+		for (int32 EventIndex = 0; EventIndex < Move.NumEvents; EventIndex++)
+		{
+			FMarioCollisionEvent Event;
+			Event.Sequence = static_cast<uint16>(Move.FirstSequence + EventIndex);
+			Event.ThisHitboxID = CharacterHitbox->GetHitboxID();
+			Event.OtherHitboxID = Other->GetHitbox()->GetHitboxID();
+			Event.Outcome = MakeStomp();
+			Event.CollisionTime = TestWorld.GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
+			Events.Add(Event);
+		}
+		FMarioMovementTestAccess::ReceiveCollisionEvents(*MoveComponent, Events);
+		MoveComponent->UpdateCharacterStateBeforeMovement(FMarioTestWorld::FrameTime);
+		TestWorld.Tick(FMarioTestWorld::FrameTime);
+		TestEqual(Move.Name, HitboxManager->GetLastFrameTimings().NumValidations, Move.ExpectedValidations);
+	}
+	return true;
+}
+
+//Idle moves combine into one, so a player standing still sends fewer moves. A move carrying collisions never combines,
+//with either an idle move or another move carrying collisions, so that its events stay with the move they happened before.
+bool FMarioCombineMovesTest::RunTest(const FString& Parameters)
+{
+	using namespace MarioSavedMoveTests;
+	FMarioTestWorld TestWorld;
+	AMarioPlayerCharacter* Character = nullptr;
+	UMarioMovementComponent* MoveComponent = SpawnCharacter(*this, *TestWorld.GetWorld(), Character);
+	if (!MoveComponent)
+	{
+		return false;
+	}
+	FNetworkPredictionData_Client_Character* ClientData = MoveComponent->GetPredictionData_Client_Character();
+	const float MaxDelta = ClientData->MaxMoveDeltaTime;
+	Character->SetRole(ROLE_AutonomousProxy);
+
+	//Each collision is cleared by running the move it was saved with, the way it is before the next move is saved.
+	const FSavedMovePtr FirstIdle = SaveMove(*Character, *ClientData);
+	const FSavedMovePtr SecondIdle = SaveMove(*Character, *ClientData);
+	FMarioMovementTestAccess::AddCollisionEvent(*MoveComponent, 0, 1, MakeStomp());
+	const FSavedMovePtr FirstCollision = SaveMove(*Character, *ClientData);
+	MoveComponent->UpdateCharacterStateBeforeMovement(FMarioTestWorld::FrameTime);
+	FMarioMovementTestAccess::AddCollisionEvent(*MoveComponent, 0, 2, MakeStomp());
+	const FSavedMovePtr SecondCollision = SaveMove(*Character, *ClientData);
+	MoveComponent->UpdateCharacterStateBeforeMovement(FMarioTestWorld::FrameTime);
+	const FSavedMovePtr IdleAfterCollision = SaveMove(*Character, *ClientData);
+	if (!TestTrue(TEXT("Saved moves created"), FirstIdle.IsValid() && SecondIdle.IsValid() && FirstCollision.IsValid() && SecondCollision.IsValid() && IdleAfterCollision.IsValid()))
+	{
+		return false;
+	}
+	TestTrue(TEXT("Idle moves combine"), FirstIdle->CanCombineWith(SecondIdle, Character, MaxDelta));
+	TestFalse(TEXT("An idle move doesn't combine with a move carrying collisions"), SecondIdle->CanCombineWith(FirstCollision, Character, MaxDelta));
+	TestFalse(TEXT("Moves carrying collisions don't combine"), FirstCollision->CanCombineWith(SecondCollision, Character, MaxDelta));
+	TestFalse(TEXT("A move carrying collisions doesn't combine with an idle move"), SecondCollision->CanCombineWith(IdleAfterCollision, Character, MaxDelta));
+	for (const FSavedMovePtr& Move : { FirstIdle, SecondIdle, FirstCollision, SecondCollision, IdleAfterCollision })
+	{
+		ClientData->FreeMove(Move);
+	}
+	Character->SetRole(ROLE_Authority);
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+﻿#include "MarioTestWorld.h"
+#include "Components/BoxComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+FMarioTestWorld::FMarioTestWorld()
+	: FMarioTestWorld([](UWorld&) {})
+{
+}
+
+FMarioTestWorld::FMarioTestWorld(TFunctionRef<void(UWorld&)> SetUpLevel)
+{
+	World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	const FURL URL;
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+	SetUpLevel(*World);
+	World->BeginPlay();
+}
+
+FMarioTestWorld::~FMarioTestWorld()
+{
+	if (World)
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+}
+
+void FMarioTestWorld::Tick(const float DeltaTime)
+{
+	World->Tick(LEVELTICK_All, DeltaTime);
+}
+
+void FMarioTestWorld::TickFrames(const int32 NumFrames, const float DeltaTime)
+{
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		Tick(DeltaTime);
+	}
+}
+
+FScopedConsoleVariableOverride::FScopedConsoleVariableOverride(const TCHAR* Name)
+	: Variable(IConsoleManager::Get().FindConsoleVariable(Name))
+{
+	if (Variable)
+	{
+		PreviousValue = Variable->GetString();
+	}
+}
+
+FScopedConsoleVariableOverride::~FScopedConsoleVariableOverride()
+{
+	if (Variable)
+	{
+		Variable->Set(*PreviousValue, ECVF_SetByCode);
+	}
+}
+
+void FScopedConsoleVariableOverride::Set(const bool bValue)
+{
+	if (Variable)
+	{
+		Variable->Set(bValue, ECVF_SetByCode);
+	}
+}
+
+void AddStaticBlock(UWorld& World, const FVector& Center, const FVector& HalfExtents)
+{
+	AActor* Block = World.SpawnActor<AActor>();
+	UBoxComponent* Box = NewObject<UBoxComponent>(Block);
+	Box->SetMobility(EComponentMobility::Static);
+	Box->SetBoxExtent(HalfExtents, false);
+	Box->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	Box->SetWorldLocation(Center);
+	Block->SetRootComponent(Box);
+	Box->RegisterComponent();
+}
+
+void WriteBenchmarkCsv(FAutomationTestBase& Test, const TCHAR* Name, const TArray<FString>& Lines)
+{
+	const FString FilePath = FPaths::Combine(FPaths::ProfilingDir(), FString::Printf(TEXT("%s_%s.csv"), Name, *FDateTime::Now().ToString()));
+	if (FFileHelper::SaveStringArrayToFile(Lines, *FilePath))
+	{
+		Test.AddInfo(FString::Printf(TEXT("Results written to %s."), *FilePath));
+	}
+	else
+	{
+		Test.AddWarning(FString::Printf(TEXT("Results couldn't be written to %s."), *FilePath));
+	}
+}
+
+#endif
\ No newline at end of file
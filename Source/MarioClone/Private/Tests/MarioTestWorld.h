@@ -0,0 +1,60 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "Templates/Function.h"
+
+class FAutomationTestBase;
+struct IConsoleVariable;
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//A game world made from nothing for automation tests, with the project's default game mode, that the test ticks by hand.
+//It needs no map and no rendering, so tests that use it run on a headless build started with -nullrhi.
+class FMarioTestWorld
+{
+public:
+
+	FMarioTestWorld();
+	//Runs SetUpLevel before the world begins play, for tests that need level geometry in place when subsystems bake it.
+	explicit FMarioTestWorld(TFunctionRef<void(UWorld&)> SetUpLevel);
+	~FMarioTestWorld();
+
+	UWorld* GetWorld() const { return World; }
+	//Ticks the whole world, which includes physics, actors, and tickable subsystems like the hitbox manager.
+	void Tick(const float DeltaTime);
+	//Ticks the world the given number of times at a fixed step.
+	void TickFrames(const int32 NumFrames, const float DeltaTime);
+
+	static constexpr float FrameTime = 1.0f / 60.0f;
+
+private:
+
+	UWorld* World = nullptr;
+};
+
+//Sets a console variable for the life of the scope and puts its previous value back afterwards.
+//Most of the settings benchmarks compare are read when a world or its actors start up, so each setting needs a test world of its own,
+//created after the setting is changed.
+class FScopedConsoleVariableOverride
+{
+public:
+
+	explicit FScopedConsoleVariableOverride(const TCHAR* Name);
+	~FScopedConsoleVariableOverride();
+
+	//False if no console variable has the name, in which case setting it does nothing.
+	bool IsValid() const { return Variable != nullptr; }
+	void Set(const bool bValue);
+
+private:
+
+	IConsoleVariable* Variable = nullptr;
+	FString PreviousValue;
+};
+
+//Adds a static box that blocks everything. Call it from SetUpLevel, so that the box is in place when the tile collision is baked.
+void AddStaticBlock(UWorld& World, const FVector& Center, const FVector& HalfExtents);
+
+//Writes a benchmark's results to a timestamped CSV in the profiling directory, named after the benchmark, and reports where it went.
+void WriteBenchmarkCsv(FAutomationTestBase& Test, const TCHAR* Name, const TArray<FString>& Lines);
+
+#endif
\ No newline at end of file
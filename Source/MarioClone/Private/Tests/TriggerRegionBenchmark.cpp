@@ -0,0 +1,75 @@
+﻿#include "Collectible.h"
+#include "MarioTestWorld.h"
+#include "GameFramework/DefaultPawn.h"
+#include "Misc/AutomationTest.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTriggerRegionBenchmark, "MarioClone.Triggers.Benchmarks.RegionGridVsPhysics",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+//Fills a fresh world with collectibles and sweeps pawns back and forth across them, once with the trigger region grid and once with physics overlaps,
+//and times each whole frame, since physics overlaps are paid for while pawns move rather than in the trigger manager's own tick.
+bool FTriggerRegionBenchmark::RunTest(const FString& Parameters)
+{
+	static constexpr int32 NumPawns = 50;
+	static constexpr int32 WarmupFrames = 30;
+	static constexpr int32 MeasuredFrames = 120;
+	static constexpr float RegionSpacing = 200.0f;
+	//Pawns cover a few regions per frame, so they enter new ones all the time.
+	static constexpr float PawnSpeed = 600.0f;
+	FScopedConsoleVariableOverride UseRegionGrid(TEXT("Triggers.UseRegionGrid"));
+	if (!TestTrue(TEXT("Triggers.UseRegionGrid exists"), UseRegionGrid.IsValid()))
+	{
+		return false;
+	}
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Regions,Source,FrameMs"));
+	for (const int32 NumRegions : { 1000, 10000 })
+	{
+		const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumRegions)));
+		const float Width = Columns * RegionSpacing;
+		for (const bool bRegionGrid : { false, true })
+		{
+			UseRegionGrid.Set(bRegionGrid);
+			FMarioTestWorld TestWorld;
+			UWorld* World = TestWorld.GetWorld();
+			for (int32 Region = 0; Region < NumRegions; Region++)
+			{
+				World->SpawnActor<ACollectible>(ACollectible::StaticClass(), FTransform(FVector((Region % Columns) * RegionSpacing, 0.0f, (Region / Columns) * RegionSpacing)));
+			}
+			TArray<ADefaultPawn*> Pawns;
+			for (int32 Pawn = 0; Pawn < NumPawns; Pawn++)
+			{
+				FActorSpawnParameters SpawnParameters;
+				SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+				Pawns.Add(World->SpawnActor<ADefaultPawn>(ADefaultPawn::StaticClass(), FTransform(FVector(0.0f, 0.0f, Pawn * Width / NumPawns)), SpawnParameters));
+			}
+			double FrameSeconds = 0.0;
+			for (int32 Frame = 0; Frame < WarmupFrames + MeasuredFrames; Frame++)
+			{
+				//Moving the pawns is timed too, since that is when physics finds their overlaps.
+				FSimpleScopeSecondsCounter FrameTimer(FrameSeconds, Frame >= WarmupFrames);
+				//Each pawn runs along its own row and wraps around at the end.
+				const float Distance = FMath::Fmod(Frame * FMarioTestWorld::FrameTime * PawnSpeed, Width);
+				for (int32 Pawn = 0; Pawn < Pawns.Num(); Pawn++)
+				{
+					if (IsValid(Pawns[Pawn]))
+					{
+						Pawns[Pawn]->SetActorLocation(FVector(Distance, 0.0f, Pawn * Width / NumPawns));
+					}
+				}
+				TestWorld.Tick(FMarioTestWorld::FrameTime);
+			}
+			const TCHAR* Source = bRegionGrid ? TEXT("RegionGrid") : TEXT("Physics");
+			const double FrameMs = FrameSeconds / MeasuredFrames * 1000.0;
+			AddInfo(FString::Printf(TEXT("%d regions, %s: %.3f ms per frame"), NumRegions, Source, FrameMs));
+			CsvLines.Add(FString::Printf(TEXT("%d,%s,%.3f"), NumRegions, Source, FrameMs));
+		}
+	}
+	WriteBenchmarkCsv(*this, TEXT("TriggerRegionBenchmark"), CsvLines);
+	return true;
+}
+
+#endif
\ No newline at end of file
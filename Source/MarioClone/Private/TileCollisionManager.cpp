@@ -0,0 +1,206 @@
+﻿#include "TileCollisionManager.h"
+#include "MarioMovementSettings.h"
+#include "EngineUtils.h"
+#include "Components/PrimitiveComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Sweep Box"), STAT_TileSweepBox, STATGROUP_TileCollision);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Box Sweeps"), STAT_TileBoxSweeps, STATGROUP_TileCollision);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Box Tests"), STAT_TileBoxTests, STATGROUP_TileCollision);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Baked Boxes"), STAT_TileBakedBoxes, STATGROUP_TileCollision);
+
+void UTileCollisionManager::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	bUseTileCollision = GetDefault<UMarioMovementSettings>()->bUseTileCollision;
+}
+
+void UTileCollisionManager::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	Boxes.Empty();
+	Tiles.Empty();
+	if (bUseTileCollision)
+	{
+		BakeLevel(InWorld);
+	}
+	SET_DWORD_STAT(STAT_TileBakedBoxes, Boxes.Num());
+}
+
+void UTileCollisionManager::BakeLevel(UWorld& InWorld)
+{
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		TInlineComponentArray<UPrimitiveComponent*> Components(*It);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (!IsValid(Component) || Component->Mobility != EComponentMobility::Static || !Component->IsQueryCollisionEnabled()
+				|| Component->GetCollisionResponseToChannel(ECC_Pawn) != ECR_Block)
+			{
+				continue;
+			}
+			const FBox Bounds = Component->Bounds.GetBox();
+			FTileCollisionBox& Box = Boxes.AddDefaulted_GetRef();
+			Box.Bounds = FBox2D(FVector2D(Bounds.Min.X, Bounds.Min.Z), FVector2D(Bounds.Max.X, Bounds.Max.Z));
+			Box.MinY = Bounds.Min.Y;
+			Box.MaxY = Bounds.Max.Y;
+			Box.Component = Component;
+		}
+	}
+	for (int32 BoxIndex = 0; BoxIndex < Boxes.Num(); BoxIndex++)
+	{
+		const FIntPoint MinTile = GetTile(Boxes[BoxIndex].Bounds.Min);
+		const FIntPoint MaxTile = GetTile(Boxes[BoxIndex].Bounds.Max);
+		for (int32 X = MinTile.X; X <= MaxTile.X; X++)
+		{
+			for (int32 Y = MinTile.Y; Y <= MaxTile.Y; Y++)
+			{
+				Tiles.FindOrAdd(FIntPoint(X, Y)).Add(BoxIndex);
+			}
+		}
+	}
+	BoxQueryStamps.Init(0, Boxes.Num());
+	QueryStamp = 0;
+	UE_LOG(LogTemp, Log, TEXT("Baked %d collision boxes into %d tiles"), Boxes.Num(), Tiles.Num());
+}
+
+bool UTileCollisionManager::SweepBox(const FVector& Start, const FVector& Delta, const FVector2D& HalfExtents, FHitResult& OutHit) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_TileSweepBox);
+	INC_DWORD_STAT(STAT_TileBoxSweeps);
+	OutHit = FHitResult(1.0f);
+	OutHit.TraceStart = Start;
+	OutHit.TraceEnd = Start + Delta;
+	if (Boxes.Num() == 0)
+	{
+		return false;
+	}
+	if (++QueryStamp == 0)
+	{
+		//The stamp wrapped around, so old stamps could match again.
+		BoxQueryStamps.Init(0, Boxes.Num());
+		QueryStamp = 1;
+	}
+
+	const FVector2D Start2D(Start.X, Start.Z);
+	const FVector2D Delta2D(Delta.X, Delta.Z);
+	const FVector2D End2D = Start2D + Delta2D;
+	const FBox2D SweptBounds(Start2D.ComponentMin(End2D) - HalfExtents, Start2D.ComponentMax(End2D) + HalfExtents);
+
+	float BestTime = 1.0f;
+	FVector2D BestNormal = FVector2D::ZeroVector;
+	int32 BestBox = INDEX_NONE;
+	//How far inside the best box the start is, or zero if it starts outside.
+	float BestPenetration = 0.0f;
+	const FIntPoint MinTile = GetTile(SweptBounds.Min);
+	const FIntPoint MaxTile = GetTile(SweptBounds.Max);
+	for (int32 X = MinTile.X; X <= MaxTile.X; X++)
+	{
+		for (int32 Y = MinTile.Y; Y <= MaxTile.Y; Y++)
+		{
+			const TArray<int32>* Tile = Tiles.Find(FIntPoint(X, Y));
+			if (!Tile)
+			{
+				continue;
+			}
+			for (const int32 BoxIndex : *Tile)
+			{
+				if (BoxQueryStamps[BoxIndex] == QueryStamp)
+				{
+					continue;
+				}
+				BoxQueryStamps[BoxIndex] = QueryStamp;
+				INC_DWORD_STAT(STAT_TileBoxTests);
+				const FTileCollisionBox& Box = Boxes[BoxIndex];
+				if (Start.Y < Box.MinY || Start.Y > Box.MaxY || !Box.Bounds.Intersect(SweptBounds))
+				{
+					continue;
+				}
+				//Grow the box by our half extents, so the sweep becomes a ray against it.
+				const FVector2D Min = Box.Bounds.Min - HalfExtents;
+				const FVector2D Max = Box.Bounds.Max + HalfExtents;
+				if (Start2D.X > Min.X && Start2D.X < Max.X && Start2D.Y > Min.Y && Start2D.Y < Max.Y)
+				{
+					//Already inside, so block along the shallowest way out if we're moving further in.
+					const float Depths[4] = { Start2D.X - Min.X, Max.X - Start2D.X, Start2D.Y - Min.Y, Max.Y - Start2D.Y };
+					const FVector2D Normals[4] = { FVector2D(-1.0f, 0.0f), FVector2D(1.0f, 0.0f), FVector2D(0.0f, -1.0f), FVector2D(0.0f, 1.0f) };
+					int32 Shallowest = 0;
+					for (int32 Side = 1; Side < 4; Side++)
+					{
+						if (Depths[Side] < Depths[Shallowest])
+						{
+							Shallowest = Side;
+						}
+					}
+					if (FVector2D::DotProduct(Delta2D, Normals[Shallowest]) < 0.0f && (BestTime > 0.0f || Depths[Shallowest] > BestPenetration))
+					{
+						BestTime = 0.0f;
+						BestNormal = Normals[Shallowest];
+						BestBox = BoxIndex;
+						BestPenetration = Depths[Shallowest];
+					}
+					continue;
+				}
+				//Slab test, keeping the axis we entered last as the hit normal.
+				float EntryTime = -UE_MAX_FLT;
+				float ExitTime = 1.0f;
+				FVector2D EntryNormal = FVector2D::ZeroVector;
+				bool bMisses = false;
+				for (int32 Axis = 0; Axis < 2 && !bMisses; Axis++)
+				{
+					if (FMath::IsNearlyZero(Delta2D[Axis]))
+					{
+						bMisses = Start2D[Axis] <= Min[Axis] || Start2D[Axis] >= Max[Axis];
+						continue;
+					}
+					const float InvDelta = 1.0f / Delta2D[Axis];
+					float Near = (Min[Axis] - Start2D[Axis]) * InvDelta;
+					float Far = (Max[Axis] - Start2D[Axis]) * InvDelta;
+					if (Near > Far)
+					{
+						Swap(Near, Far);
+					}
+					if (Near > EntryTime)
+					{
+						EntryTime = Near;
+						EntryNormal = FVector2D::ZeroVector;
+						EntryNormal[Axis] = Delta2D[Axis] > 0.0f ? -1.0f : 1.0f;
+					}
+					ExitTime = FMath::Min(ExitTime, Far);
+					bMisses = EntryTime >= ExitTime;
+				}
+				if (!bMisses && EntryTime >= 0.0f && EntryTime < BestTime)
+				{
+					BestTime = EntryTime;
+					BestNormal = EntryNormal;
+					BestBox = BoxIndex;
+					BestPenetration = 0.0f;
+				}
+			}
+		}
+	}
+	if (BestBox == INDEX_NONE)
+	{
+		return false;
+	}
+
+	//Stop just short of the surface, like a physics sweep does, so the next move doesn't start inside it.
+	const float DeltaSize = Delta2D.Size();
+	const float PulledBackTime = DeltaSize > UE_KINDA_SMALL_NUMBER ? FMath::Max(0.0f, BestTime - 0.1f / DeltaSize) : 0.0f;
+	const FVector Normal(BestNormal.X, 0.0f, BestNormal.Y);
+	OutHit.bBlockingHit = true;
+	OutHit.Time = PulledBackTime;
+	OutHit.Distance = DeltaSize * PulledBackTime;
+	OutHit.Location = Start + Delta * PulledBackTime;
+	OutHit.Normal = Normal;
+	OutHit.ImpactNormal = Normal;
+	OutHit.ImpactPoint = OutHit.Location - Normal * FVector(HalfExtents.X, 0.0f, HalfExtents.Y);
+	//Starting inside is reported like a physics sweep does, so that movement pushes the pawn back out along the normal.
+	OutHit.bStartPenetrating = BestPenetration > 0.0f;
+	OutHit.PenetrationDepth = BestPenetration;
+	if (UPrimitiveComponent* Component = Boxes[BestBox].Component.Get())
+	{
+		OutHit.Component = Component;
+		OutHit.HitObjectHandle = FActorInstanceHandle(Component->GetOwner());
+	}
+	return true;
+}
@@ -0,0 +1,220 @@
+﻿#include "TriggerRegionManager.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Test Pawns"), STAT_TriggerTestPawns, STATGROUP_Triggers);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Tests"), STAT_TriggerRegionTests, STATGROUP_Triggers);
+
+static TAutoConsoleVariable<bool> CVarUseTriggerRegionGrid(
+	TEXT("Triggers.UseRegionGrid"),
+	true,
+	TEXT("Test pawns against killboxes, level goals, and collectibles with the trigger region grid instead of physics overlaps. Takes effect for worlds created afterwards."));
+
+void UTriggerRegionManager::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	//This has to be decided before any trigger actors begin play, since it determines how they set up their collision.
+	bUseRegionGrid = CVarUseTriggerRegionGrid.GetValueOnGameThread();
+}
+
+void UTriggerRegionManager::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	Regions.Empty();
+	GridCells.Empty();
+	LargeRegions.Empty();
+	OverlappingPawns.Empty();
+	CurrentOverlaps.Empty();
+	Entered.Empty();
+	Candidates.Empty();
+	RegionQueryStamps.Empty();
+	QueryStamp = 0;
+	bGridDirty = false;
+}
+
+int32 UTriggerRegionManager::RegisterBoxRegion(const FBox& Box, const FTriggerRegionCallback& Callback)
+{
+	FTriggerRegion Region;
+	Region.Bounds = FBox2D(FVector2D(Box.Min.X, Box.Min.Z), FVector2D(Box.Max.X, Box.Max.Z));
+	Region.Callback = Callback;
+	return AddRegion(MoveTemp(Region));
+}
+
+int32 UTriggerRegionManager::RegisterSphereRegion(const FVector& Center, const float Radius, const FTriggerRegionCallback& Callback)
+{
+	FTriggerRegion Region;
+	Region.bIsCircle = true;
+	Region.Center = FVector2D(Center.X, Center.Z);
+	Region.Radius = Radius;
+	Region.Bounds = FBox2D(Region.Center - FVector2D(Radius), Region.Center + FVector2D(Radius));
+	Region.Callback = Callback;
+	return AddRegion(MoveTemp(Region));
+}
+
+int32 UTriggerRegionManager::AddRegion(FTriggerRegion&& Region)
+{
+	bGridDirty = true;
+	return Regions.Add(MoveTemp(Region));
+}
+
+void UTriggerRegionManager::UnregisterRegion(const int32 RegionID)
+{
+	if (!Regions.IsValidIndex(RegionID))
+	{
+		return;
+	}
+	Regions[RegionID].bRegistered = false;
+	Regions[RegionID].Callback.Unbind();
+	bGridDirty = true;
+}
+
+void UTriggerRegionManager::SetRegionEnabled(const int32 RegionID, const bool bEnabled)
+{
+	if (!Regions.IsValidIndex(RegionID) || Regions[RegionID].bEnabled == bEnabled)
+	{
+		return;
+	}
+	Regions[RegionID].bEnabled = bEnabled;
+	//Forget which pawns were inside, so that any pawn still inside when the region is enabled again counts as entering it.
+	if (!bEnabled)
+	{
+		for (auto It = OverlappingPawns.CreateIterator(); It; ++It)
+		{
+			if (It->Key == RegionID)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+void UTriggerRegionManager::RebuildGrid()
+{
+	GridCells.Empty();
+	LargeRegions.Empty();
+	for (int32 RegionID = 0; RegionID < Regions.Num(); RegionID++)
+	{
+		const FTriggerRegion& Region = Regions[RegionID];
+		if (!Region.bRegistered)
+		{
+			continue;
+		}
+		const FIntPoint MinCell = GetCell(Region.Bounds.Min);
+		const FIntPoint MaxCell = GetCell(Region.Bounds.Max);
+		if ((MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1) > MaxCellsPerRegion)
+		{
+			LargeRegions.Add(RegionID);
+			continue;
+		}
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				GridCells.FindOrAdd(FIntPoint(X, Y)).Add(RegionID);
+			}
+		}
+	}
+	RegionQueryStamps.Init(0, Regions.Num());
+	QueryStamp = 0;
+	bGridDirty = false;
+}
+
+bool UTriggerRegionManager::OverlapsRegion(const FTriggerRegion& Region, const FBox2D& PawnBounds)
+{
+	if (!Region.Bounds.Intersect(PawnBounds))
+	{
+		return false;
+	}
+	if (!Region.bIsCircle)
+	{
+		return true;
+	}
+	//Closest point on the pawn's bounds to the circle's center.
+	const FVector2D Closest(FMath::Clamp(Region.Center.X, PawnBounds.Min.X, PawnBounds.Max.X), FMath::Clamp(Region.Center.Y, PawnBounds.Min.Y, PawnBounds.Max.Y));
+	return FVector2D::DistSquared(Closest, Region.Center) <= FMath::Square(Region.Radius);
+}
+
+void UTriggerRegionManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	//All trigger logic is authoritative, so there's nothing to do on clients.
+	if (!bUseRegionGrid || GetWorld()->IsNetMode(NM_Client) || Regions.Num() == 0)
+	{
+		return;
+	}
+	if (bGridDirty)
+	{
+		RebuildGrid();
+	}
+
+	CurrentOverlaps.Reset();
+	Entered.Reset();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TriggerTestPawns);
+		for (TActorIterator<APawn> It(GetWorld()); It; ++It)
+		{
+			APawn* Pawn = *It;
+			if (!IsValid(Pawn) || !IsValid(Pawn->GetRootComponent()))
+			{
+				continue;
+			}
+			//Pawns collide with triggers using their root component, which for characters is the capsule.
+			const FBox PawnBox = Pawn->GetRootComponent()->Bounds.GetBox();
+			const FBox2D PawnBounds(FVector2D(PawnBox.Min.X, PawnBox.Min.Z), FVector2D(PawnBox.Max.X, PawnBox.Max.Z));
+			Candidates.Reset();
+			Candidates.Append(LargeRegions);
+			if (++QueryStamp == 0)
+			{
+				//The stamp wrapped around, so old stamps could match again.
+				RegionQueryStamps.Init(0, Regions.Num());
+				QueryStamp = 1;
+			}
+			const FIntPoint MinCell = GetCell(PawnBounds.Min);
+			const FIntPoint MaxCell = GetCell(PawnBounds.Max);
+			for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+			{
+				for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+				{
+					if (const TArray<int32>* Cell = GridCells.Find(FIntPoint(X, Y)))
+					{
+						for (const int32 RegionID : *Cell)
+						{
+							if (RegionQueryStamps[RegionID] != QueryStamp)
+							{
+								RegionQueryStamps[RegionID] = QueryStamp;
+								Candidates.Add(RegionID);
+							}
+						}
+					}
+				}
+			}
+			INC_DWORD_STAT_BY(STAT_TriggerRegionTests, Candidates.Num());
+			for (const int32 RegionID : Candidates)
+			{
+				const FTriggerRegion& Region = Regions[RegionID];
+				if (!Region.bRegistered || !Region.bEnabled || !OverlapsRegion(Region, PawnBounds))
+				{
+					continue;
+				}
+				const TPair<int32, TWeakObjectPtr<APawn>> Overlap(RegionID, Pawn);
+				CurrentOverlaps.Add(Overlap);
+				if (!OverlappingPawns.Contains(Overlap))
+				{
+					Entered.Add(Overlap);
+				}
+			}
+		}
+	}
+	Swap(OverlappingPawns, CurrentOverlaps);
+	//Callbacks can kill pawns or disable regions, so they only run once all of the testing is done.
+	for (const TPair<int32, TWeakObjectPtr<APawn>>& Overlap : Entered)
+	{
+		const FTriggerRegion& Region = Regions[Overlap.Key];
+		if (Region.bEnabled && Overlap.Value.IsValid())
+		{
+			Region.Callback.ExecuteIfBound(Overlap.Value.Get());
+		}
+	}
+}
\ No newline at end of file
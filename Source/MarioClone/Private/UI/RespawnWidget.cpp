@@ -27,8 +27,8 @@ void URespawnWidget::NativeTick(const FGeometry& MyGeometry, float InDeltaTime)
 	}
 	if (IsValid(RespawnProgress))
 	{
-		const float CurrentTime = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
-		const float Percent = (CurrentTime - RespawnStartTime) / FMath::Max(0.01f, (RespawnEndTime - RespawnStartTime));
-		RespawnProgress->SetPercent(FMath::Clamp(Percent, 0.0f, 1.0f));
+		const double CurrentTime = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
+		const double Percent = (CurrentTime - RespawnStartTime) / FMath::Max(0.01, (RespawnEndTime - RespawnStartTime));
+		RespawnProgress->SetPercent(static_cast<float>(FMath::Clamp(Percent, 0.0, 1.0)));
 	}
 }
\ No newline at end of file
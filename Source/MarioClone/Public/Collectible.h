@@ -9,6 +9,7 @@
 
 class UPaperSpriteComponent;
 class USphereComponent;
+class UTriggerRegionManager;
 
 UCLASS()
 class MARIOCLONE_API ACollectible : public AActor
@@ -20,6 +21,7 @@ public:
 	ACollectible();
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 
@@ -33,6 +35,13 @@ private:
 	UFUNCTION()
 	void OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 		UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+	void Collect(AActor* Actor);
+
+	//Used instead of the collision sphere's overlap events when the trigger region grid is enabled.
+	UPROPERTY()
+	UTriggerRegionManager* TriggerManager = nullptr;
+	int32 TriggerRegionID = INDEX_NONE;
+	void OnRegionEntered(APawn* Pawn);
 
 	//How much this collectible is worth to a player.
 	UPROPERTY(EditAnywhere, Category = "Collectible")
@@ -1,11 +1,37 @@
 ﻿#pragma once
 #include "CoreMinimal.h"
 #include "CombatInterface.h"
+#include "HitboxArchetype.h"
 #include "Components/SphereComponent.h"
 #include "Hitbox.generated.h"
 
 class UHitbox;
 
+//The outline a hitbox collides with, in the X/Z plane.
+UENUM()
+enum class EHitboxShape : uint8
+{
+	Circle = 0,
+	Capsule = 1,
+	Box = 2
+};
+
+//Everything that decides a hitbox's shape apart from its transform.
+//This is copied out of the component on the game thread, so that shapes can be built from it on any thread.
+struct FHitboxShapeSettings
+{
+	EHitboxShape Shape = EHitboxShape::Circle;
+	float SphereRadius = 0.0f;
+	float CapsuleRadius = 0.0f;
+	float CapsuleHalfHeight = 0.0f;
+	FVector2D BoxHalfExtents = FVector2D::ZeroVector;
+
+	//Rotation in the X/Z plane is whatever turns the component's X axis towards Z.
+	static float GetPlaneAngle(const FQuat& Rotation);
+	FHitboxShape2D MakeShape2D(const FVector& Scale, const float Angle) const;
+	FHitboxShape2D MakeShape2D(const FVector& Scale, const FQuat& Rotation) const { return MakeShape2D(Scale, GetPlaneAngle(Rotation)); }
+};
+
 DECLARE_DYNAMIC_DELEGATE_FiveParams(FHitboxCallback, UHitbox*, CollidingHitbox, const FVector&, BounceToThis, const float, DamageToThis, const FVector&, BounceToOther, const float, DamageToOther);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_FiveParams(FHitboxNotification, UHitbox*, CollidingHitbox, const FVector&, BounceToThis, const float, DamageToThis, const FVector&, BounceToOther, const float, DamageToOther);
 
@@ -21,10 +47,13 @@ public:
 	UHitbox();
 	virtual void InitializeComponent() override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 	EHostility GetHostility() const { return OwnerHostility; }
 	int32 GetHitboxID() const { return HitboxID; }
+	//Index of this hitbox's interned archetype in the hitbox manager.
+	int32 GetArchetypeIndex() const { return ArchetypeIndex; }
 	bool IsOwnerLocallyControlled() const;
 
 private:
@@ -35,6 +64,9 @@ private:
 	//This unique ID is used to identify hitboxes across the network to verify bounces on the server.
 	UPROPERTY(ReplicatedUsing = OnRep_HitboxID)
 	int32 HitboxID = -1;
+	//Assigned by the server alongside the ID, so that every machine refers to the same archetype by the same index.
+	UPROPERTY(Replicated)
+	int32 ArchetypeIndex = -1;
 	//This registers the hitbox with the local HitboxManager, ensuring that all clients have an accurate map of bounce boxes to IDs for bouncing.
 	UFUNCTION()
 	void OnRep_HitboxID();
@@ -46,17 +78,19 @@ public:
 
 	void EnableHitbox();
 	void DisableHitbox();
+	bool IsHitboxEnabled() const { return bHitboxEnabled; }
 	
 	float GetCollisionThreshold() const;
-	
-	bool IsBouncy() const { return bIsBouncy; }
-	bool CanBeBounced() const { return bCanBeBounced; }
-	FVector GetBounceImpulse() const { return BounceImpulse; }
-	
-	bool DealsCollisionDamage() const { return bDealsCollisionDamage; }
-	bool CanBeCollisionDamaged() const { return bCanBeCollisionDamaged; }
-	float GetCollisionDamageDone() const { return CollisionDamage; }
+	//This hitbox's shape at its current scale and rotation. For circles, this is just the sphere's radius.
+	FHitboxShape2D GetShape2D() const;
+	FHitboxShapeSettings GetShapeSettings() const;
+	//The settings this hitbox registers its archetype with: the archetype asset's if one is set, or otherwise the settings on this component.
+	FHitboxArchetypeData GetArchetypeData() const;
 
+	//Since two hitboxes colliding triggers two overlap events (one for each hitbox), this function can deterministically pick one hitbox to actually perform calculations.
+	//The hitbox that isn't selected will receive the result of the collision from the hitbox that is selected.
+	//It can also just opt to not perform calculations at all for hitboxes of the same team.
+	bool ShouldProcessCollision(const UHitbox* OtherHitbox) const;
 	//Called from another hitbox that handled a collision with this hitbox.
 	void NotifyOfCollisionResult(UHitbox* CollidingHitbox, const FVector& BounceToThis, const float DamageToThis, const FVector& BounceToOther, const float DamageToOther);
 
@@ -65,21 +99,38 @@ public:
 
 private:
 
-	static const FName HitboxProfile;
+	//Each hostility has its own object channel and profile, which ignores its own channel.
+	//Hitboxes of the same hostility never process collisions with each other, so physics doesn't need to report those overlaps at all.
+	static const FName NeutralHitboxProfile;
+	static const FName EnemyHitboxProfile;
+	static const FName AllyHitboxProfile;
+	static FName GetHitboxProfile(const EHostility Hostility);
+	void ApplyHitboxProfile();
+	bool bHitboxEnabled = true;
 	
+	//Shared settings for this hitbox. If set, this replaces the threshold, bounce, and damage settings below.
 	UPROPERTY(EditAnywhere, Category = "Hitbox")
+	UHitboxArchetype* Archetype = nullptr;
+	UPROPERTY(EditAnywhere, Category = "Hitbox", meta = (EditCondition = "Archetype == nullptr"))
 	float CollisionThreshold = 0.75;
 
+	//Capsules and boxes fit tall or wide characters better than a circle would.
+	//For these shapes the sphere radius is overwritten with the radius of the circle around the shape, which is what physics and the broadphase use.
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Shape")
+	EHitboxShape Shape = EHitboxShape::Circle;
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Shape", meta = (EditCondition = "Shape == EHitboxShape::Capsule", EditConditionHides))
+	float CapsuleRadius = 40.0f;
+	//Half of the capsule's height, including its caps. The capsule stands upright along Z before the component's rotation.
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Shape", meta = (EditCondition = "Shape == EHitboxShape::Capsule", EditConditionHides))
+	float CapsuleHalfHeight = 80.0f;
+	//Half extents along X and Z, before the component's rotation.
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Shape", meta = (EditCondition = "Shape == EHitboxShape::Box", EditConditionHides))
+	FVector2D BoxHalfExtents = FVector2D(50.0f, 50.0f);
+
 	//Callback from native component OnBeginOverlap for this hitbox.
 	UFUNCTION()
 	void OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 		UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-	//Since two hitboxes colliding triggers two overlap events (one for each hitbox), this function can deterministically pick one hitbox to actually perform calculations.
-	//The hitbox that isn't selected will receive the result of the collision from the hitbox that is selected.
-	//It can also just opt to not perform calculations at all for hitboxes of the same team.
-	bool ShouldProcessCollision(UHitbox* OtherHitbox) const;
-	//Performs the actual bounce impulse and damage value calculations based on hitbox locations.
-	void ProcessCollision(UHitbox* OtherHitbox, FVector& ImpulseToThis, FVector& ImpulseToOther, float& DamageToThis, float& DamageToOther) const;
 	//Delegate called when a collision is processed for this hitbox with the resulting bounce and damage info.
 	FHitboxNotification OnHitboxCollision;
 
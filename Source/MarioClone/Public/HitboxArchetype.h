@@ -0,0 +1,50 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "HitboxCollision.h"
+#include "Engine/DataAsset.h"
+#include "HitboxArchetype.generated.h"
+
+//The shared settings that decide how a hitbox collides with others.
+//Hitboxes don't use these directly; the hitbox manager interns them so that every hitbox with the same settings refers to one archetype by index.
+USTRUCT(BlueprintType)
+struct FHitboxArchetypeData
+{
+	GENERATED_BODY()
+
+	//Fraction of the hitbox's height, from the bottom, that another hitbox's bottom must be above to count as landing on top.
+	UPROPERTY(EditAnywhere, Category = "Hitbox")
+	float CollisionThreshold = 0.75f;
+
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Bounce")
+	bool bIsBouncy = true;
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Bounce", meta = (EditCondition = "bIsBouncy"))
+	FVector BounceImpulse = FVector(0.0f, 0.0f, 1000.0f);
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Bounce")
+	bool bCanBeBounced = false;
+
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Damage")
+	bool bDealsCollisionDamage = true;
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Damage", meta = (EditCondition = "bDealsCollisionDamage"))
+	float CollisionDamage = 50.0f;
+	UPROPERTY(EditAnywhere, Category = "Hitbox|Damage")
+	bool bCanBeCollisionDamaged = true;
+
+	EHitboxCapabilities GetCapabilities() const;
+	bool operator==(const FHitboxArchetypeData& Other) const;
+};
+
+//An archetype that many hitboxes can share, such as every instance of one enemy type.
+UCLASS(BlueprintType)
+class MARIOCLONE_API UHitboxArchetype : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	const FHitboxArchetypeData& GetData() const { return Data; }
+
+private:
+
+	UPROPERTY(EditAnywhere, Category = "Hitbox", meta = (ShowOnlyInnerProperties))
+	FHitboxArchetypeData Data;
+};
\ No newline at end of file
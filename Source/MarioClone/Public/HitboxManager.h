@@ -1,28 +1,266 @@
 ﻿#pragma once
 #include "CoreMinimal.h"
+#include "CombatInterface.h"
+#include "Hitbox.h"
+#include "Containers/Queue.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "HitboxManager.generated.h"
 
-class UHitbox;
+DECLARE_STATS_GROUP(TEXT("Hitboxes"), STATGROUP_Hitboxes, STATCAT_Advanced);
 
-USTRUCT()
-struct FHitboxSnapshot
+//Frame-major lag compensation history shared by all hitboxes, indexed by server frame number.
+//Frames are numbered from 0 as they are recorded, and frame N lives in ring entry N % MaxFrames.
+//Each frame only stores the slots that moved during it: a bitmask with one bit per slot says which slots the frame recorded,
+//and their positions are packed in slot order into a ring of entries shared by every frame.
+//Slots that are still or disabled only cost their bit, however many of them there are and however long the history is.
+//A slot's position at any frame is the one from the newest frame at or before it that recorded the slot.
+//Positions can be stored quantized: since movement is constrained to the X/Z plane, only X and Z are kept per entry,
+//as fixed-point offsets from the level's origin. Y is kept once per slot.
+struct FHitboxWorldHistory
 {
-	GENERATED_BODY()
+	void Init(const int32 InMaxFrames, const bool bInQuantized, const FVector& InOrigin);
+	//Widens every frame's bitmask and the per-slot state to fit at least this many slots.
+	void EnsureSlotCapacity(const int32 NumSlots);
+	//Lengthens the ring to hold more frames, keeping every frame already recorded.
+	void EnsureFrameCapacity(const int32 NewMaxFrames);
+	//Starts recording a new frame, dropping the oldest one if the history is full, and returns the new frame's number.
+	int64 AddFrame(const double Timestamp);
+	//Hands a slot to a new occupant, which holds this position from its first frame until it is recorded.
+	//Anything recorded in the slot before its first frame belonged to the previous occupant and is never read again.
+	void ResetSlot(const int32 Slot, const int64 FirstFrame, const FVector& Position);
+	//Records a slot's position in the newest frame. Each slot can only be recorded once per frame, and slots have to be recorded in increasing order.
+	void RecordPosition(const int32 Slot, const FVector& Position);
 
-	float Timestamp = 0.0f;
-	FVector Location = FVector::ZeroVector;
+	int32 NumFrames() const { return Count; }
+	int32 GetMaxFrames() const { return MaxFrames; }
+	bool IsFull() const { return Count == MaxFrames; }
+	int64 GetNewestFrame() const { return NextFrame - 1; }
+	int64 GetOldestFrame() const { return NextFrame - Count; }
+	double GetFrameTime(const int64 Frame) const { return FrameTimes[GetRingIndex(Frame)]; }
+	int64 GetFirstFrame(const int32 Slot) const { return SlotFirstFrames[Slot]; }
+	//Where the slot was when it was last recorded, or reset if it hasn't been recorded since.
+	const FVector& GetLatestPosition(const int32 Slot) const { return LatestPositions[Slot]; }
+	//Frames before the slot's first frame read as its first frame.
+	FVector GetPosition(const int64 Frame, const int32 Slot) const;
+	bool IsQuantized() const { return bQuantized; }
+	//Furthest a position read back from the history can be from the one that was recorded, in the X/Z plane.
+	//Quantized positions are rounded to the nearest step on both axes, so they can be off by half a step on each, and interpolating between two of them can't be off by more.
+	double GetPositionError() const { return bQuantized ? QuantizationStep * 0.5 * UE_DOUBLE_SQRT_2 : 0.0; }
+	//Number of positions currently stored across every frame.
+	int32 NumEntries() const { return static_cast<int32>(NextEntry - FirstEntry); }
+	//Size of the history's storage, for memory stats.
+	SIZE_T GetAllocatedSize() const;
+	//Binary search for the recorded frames on either side of the timestamp.
+	//CurrentTime is used as the time of the after frame when the timestamp is newer than anything recorded.
+	FHitboxRewindFrame FindRewindFrame(const double Timestamp, const double CurrentTime) const;
+
+private:
+
+	static constexpr int32 SlotsPerMaskWord = 64;
+
+	int32 GetRingIndex(const int64 Frame) const { return static_cast<int32>(Frame % MaxFrames); }
+	int32 GetEntryIndex(const int64 Entry) const { return static_cast<int32>(Entry % EntryCapacity); }
+	//Returns the number of the entry the frame recorded the slot in, or INDEX_NONE if the frame didn't record the slot.
+	int64 FindEntry(const int64 Frame, const int32 Slot) const;
+	FVector GetEntryPosition(const int64 Entry, const int32 Slot) const;
+	void SetEntryPosition(const int64 Entry, const int32 Slot, const FVector& Position);
+	//Drops the oldest frame. The positions it recorded become the base positions of their slots.
+	void RemoveOldestFrame();
+	void EnsureEntryCapacity(const int32 NumNeeded);
+	//Moves each frame's bitmask words into a larger array, where frames and words may be laid out differently.
+	template<typename T>
+	void RelayoutMasks(TArray<T>& Masks, const int32 NewMaxFrames, const int32 NewMaskWords) const;
+	//Moves the stored entries into a larger ring.
+	template<typename T>
+	void RelayoutEntries(TArray<T>& Entries, const int32 NewCapacity) const;
 
-	FHitboxSnapshot() {}
-	FHitboxSnapshot(const float InTime, const FVector& InLoc) : Timestamp(InTime), Location(InLoc) {}
+	//Size of one quantization step in world units. 2 x int32 at this step covers over 21 million units each way from the origin.
+	static constexpr double QuantizationStep = 0.01;
+	//Positions further than this from the origin don't fit in an int32 and are clamped to it, rather than wrapping around to the other side of the world.
+	static constexpr double MaxQuantizedDistance = MAX_int32 * QuantizationStep;
+	static int32 Quantize(const double Value, const double Origin);
+	static double Dequantize(const int32 Value, const double Origin) { return Origin + Value * QuantizationStep; }
+
+	int32 MaxFrames = 0;
+	int64 NextFrame = 0;
+	int32 Count = 0;
+	//Server world time of each frame. These are doubles so that the spacing between frames stays exact however long the server has been up.
+	TArray<double> FrameTimes;
+	//Number of the first entry each frame recorded. Entries are numbered from 0 as they are recorded, and entry N lives in ring entry N % EntryCapacity.
+	TArray<int64> FrameFirstEntries;
+	//One bit per slot for each frame, set for the slots the frame recorded. Each frame has MaskWords words.
+	int32 MaskWords = 0;
+	TArray<uint64> RecordedMasks;
+	//For each word of each frame's bitmask, how many entries the frame recorded for the slots before that word.
+	//Together with a population count within the word, this finds a slot's entry without scanning the frame.
+	TArray<uint32> MaskEntryOffsets;
+	int64 FirstEntry = 0;
+	int64 NextEntry = 0;
+	int32 EntryCapacity = 0;
+	//Only one of these is used, depending on whether the history is quantized.
+	TArray<FVector> Positions;
+	TArray<FIntPoint> QuantizedPositions;
+	bool bQuantized = false;
+	FVector Origin = FVector::ZeroVector;
+
+	//The first frame of each slot's current occupant.
+	TArray<int64> SlotFirstFrames;
+	//Every frame after this one holds the slot's latest position, since the slot hasn't moved since.
+	TArray<int64> LastRecordedFrames;
+	TArray<FVector> LatestPositions;
+	//Where each slot was before the oldest frame still kept, for slots that haven't moved since.
+	TArray<FVector> BasePositions;
+	//Y of each slot's current occupant, used when the history is quantized.
+	TArray<double> PlaneY;
 };
 
+//A registered hitbox.
+//Slots are reused when hitboxes unregister, so the generation is bumped on release to invalidate old IDs.
 USTRUCT()
-struct FHitboxSnapshotArray
+struct FHitboxSlot
 {
 	GENERATED_BODY();
 
-	TArray<FHitboxSnapshot> Snapshots;
+	UPROPERTY()
+	UHitbox* Hitbox = nullptr;
+	int32 Generation = 0;
+	//Whether the broadphase currently has an entry for this slot's hitbox.
+	bool bInBroadphase = false;
+};
+
+enum class EHitboxStateFlags : uint8
+{
+	None = 0,
+	//Set while the slot holds a live hitbox.
+	Registered = 1 << 0,
+	//Cleared while the hitbox is disabled, for example while its owner is dead.
+	Enabled = 1 << 1
+};
+ENUM_CLASS_FLAGS(EHitboxStateFlags);
+
+//Structure-of-arrays copy of the hitbox state used by the hot server paths, indexed by slot.
+//Refreshed from the UHitbox components once per frame so that recording and validation never touch the components themselves.
+//Refreshing is split in two: gathering copies raw state out of the components and has to run on the game thread,
+//while updating shapes is pure math on the gathered copies and can run on any thread.
+struct FHitboxStateMirror
+{
+	TArray<FVector> Positions;
+	TArray<FQuat> Rotations;
+	TArray<FVector> Scales;
+	TArray<FHitboxShapeSettings> ShapeSettings;
+	//Radius of the circle around each hitbox's shape.
+	TArray<float> Radii;
+	//Rotation isn't recorded in the history, so rewound hitboxes are tested with their current shape.
+	TArray<FHitboxShape2D> Shapes;
+	//Bounce and damage settings are shared between hitboxes, so only the index of each hitbox's archetype is kept here.
+	TArray<int32> ArchetypeIndices;
+	TArray<EHostility> Hostilities;
+	TArray<EHitboxStateFlags> Flags;
+
+	void SetNum(const int32 NewNum);
+	//Gathers and updates together, for single hitboxes on the game thread.
+	void Refresh(const int32 Index, const UHitbox* Hitbox);
+	void Gather(const int32 Index, const UHitbox* Hitbox);
+	void UpdateShape(const int32 Index);
+	void Clear(const int32 Index);
+	SIZE_T GetAllocatedSize() const;
+	bool HasFlags(const int32 Index, const EHitboxStateFlags InFlags) const { return EnumHasAllFlags(Flags[Index], InFlags); }
+};
+
+//A collision reported by a client, waiting to be replayed at the end of the server frame.
+struct FHitboxValidationRequest
+{
+	int32 ThisHitboxID = -1;
+	int32 OtherHitboxID = -1;
+	double CollisionTime = -1.0;
+	//Where the hitbox that processed the collision was while the server simulated the move that reported it.
+	FVector ThisLocation = FVector::ZeroVector;
+	FHitboxCollisionOutcome Outcome;
+};
+
+//A hitbox's extent along X for the sweep-and-prune broadphase, along with what's needed for the exact tests.
+//The extent covers the hitbox's whole path since last frame, so that fast hitboxes can't pass through each other between frames.
+struct FHitboxBroadphaseEntry
+{
+	int32 HitboxID = -1;
+	double MinX = 0.0;
+	double MaxX = 0.0;
+	FVector PreviousLocation = FVector::ZeroVector;
+	FVector Location = FVector::ZeroVector;
+	float Radius = 0.0f;
+	FHitboxShape2D Shape;
+	//Hitboxes of the same hostility never collide, so the sweep skips those pairs just like the per-hostility collision profiles do.
+	EHostility Hostility = EHostility::Neutral;
+};
+
+//A contact between two hitboxes that started touching this frame, as reported by a physics overlap or the broadphase.
+struct FHitboxPendingContact
+{
+	//Pair of the hitboxes' IDs, or UnregisteredPairKey if either hitbox hasn't been given an ID yet.
+	uint64 PairKey = 0;
+	//The two hitboxes, ordered like the IDs in the pair key. Contacts are kept by hitbox rather than by ID,
+	//since on clients a hitbox can start touching things before its ID has replicated.
+	TWeakObjectPtr<UHitbox> First;
+	TWeakObjectPtr<UHitbox> Second;
+	//How far through the frame the hitboxes first touched, from 0 at the start of the frame to 1 at the end.
+	//Physics overlaps don't report this, so it is worked out when the contact is resolved.
+	float TimeOfImpact = 1.0f;
+	//Where each hitbox was at the time of impact, ordered like the IDs in the pair key. Only set by the swept broadphase test.
+	bool bHasImpactLocations = false;
+	FVector FirstLocation = FVector::ZeroVector;
+	FVector SecondLocation = FVector::ZeroVector;
+};
+
+//A contact between two hitboxes, with both hitboxes' state gathered on the game thread so that it can be resolved on any thread.
+struct FHitboxContact
+{
+	//The hitbox that processes the contact, and the one it collided with.
+	TWeakObjectPtr<UHitbox> Processor;
+	TWeakObjectPtr<UHitbox> Other;
+	FHitboxCollisionParams ProcessorParams;
+	FHitboxCollisionParams OtherParams;
+	float TimeOfImpact = 1.0f;
+	//Swept contacts were already tested exactly at their time of impact. Physics overlaps still need testing against the current locations.
+	bool bNeedsOverlapTest = true;
+	//Where both hitboxes were at the end of the last frame, for working out the time of impact of physics overlaps.
+	//Hitboxes that weren't in the state mirror last frame, like ones whose IDs haven't replicated, don't have these and touch at the end of the frame.
+	bool bHasStartLocations = false;
+	FVector ProcessorStart = FVector::ZeroVector;
+	FVector OtherStart = FVector::ZeroVector;
+};
+
+//A contact between two hitboxes that has been resolved, waiting for its result to be sent to both hitboxes.
+struct FHitboxContactResult
+{
+	//Index of the resolved contact in the manager's contact list, which is already in the order results are sent out.
+	int32 Contact = INDEX_NONE;
+	float TimeOfImpact = 1.0f;
+	FHitboxCollisionResult Result;
+};
+
+//How long the hitbox manager's main paths took over one frame, in seconds, along with how much work they had.
+//These are always gathered, since it only takes a few timer reads per frame. The hitbox stress test writes them out every frame.
+struct FHitboxFrameTimings
+{
+	double Tick = 0.0;
+	double Register = 0.0;
+	double Broadphase = 0.0;
+	double ResolveContacts = 0.0;
+	//Validation rewinds every request's hitbox, so the time spent rewinding for validation is also counted in Validate.
+	double Rewind = 0.0;
+	double Validate = 0.0;
+	int32 NumHitboxes = 0;
+	int32 NumContacts = 0;
+	int32 NumValidations = 0;
+	//Overlap events physics reported between hitboxes, counting both hitboxes' events for the same contact.
+	int32 NumOverlapEvents = 0;
+	//Capacity of the manager's own containers. This misses temporary allocations, which the tracked bytes below include.
+	SIZE_T AllocatedBytes = 0;
+	//Live bytes the low level memory tracker attributes to each path, as of its last update. These are only filled in when running with -llm.
+	int64 RegisterTrackedBytes = 0;
+	int64 BroadphaseTrackedBytes = 0;
+	int64 RewindTrackedBytes = 0;
+	int64 ValidateTrackedBytes = 0;
 };
 
 UCLASS()
@@ -33,28 +271,155 @@ class MARIOCLONE_API UHitboxManager : public UTickableWorldSubsystem
 public:
 
 	virtual bool ShouldCreateSubsystem(UObject* Outer) const override { return true; }
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
 	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Always; }
-	virtual TStatId GetStatId() const override { return TStatId(); }
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UHitboxManager, STATGROUP_Hitboxes); }
 	virtual void Tick(float DeltaTime) override;
 	
 	FVector GetBounceImpulseForHitbox(const int32 HitboxID) const;
-	bool SanityCheckBounce(const int32 HitboxIDA, const int32 HitboxIDB, const float PingTime) const;
+	//Check of a bounce a client reported, used to apply the bounce to the client's own movement during the move.
+	//The other hitbox is rewound to the collision time and the bounce is replayed, the same way validation replays it at the end of the frame.
+	//Must be called while the server simulates the move that reported the bounce, since that is when this hitbox is where the client had it.
+	bool CanHitboxBounceOff(const int32 ThisHitboxID, const int32 OtherHitboxID, const double CollisionTime) const;
+	//Queues a collision a client reported to be replayed at the end of the frame, with the other hitbox rewound to the server time the client saw it at.
+	//Outcomes that reproduce on the server are then applied to both hitboxes through ConfirmCollisionOfHitboxes.
+	void QueueCollisionValidation(const int32 ThisHitboxID, const int32 OtherHitboxID, const double CollisionTime, const FHitboxCollisionOutcome& Outcome);
+	//Returns the index of the archetype with these settings, adding it if no registered archetype matches.
+	//Returns INDEX_NONE once MaxArchetypes are registered, and the hitbox then uses its own archetype data.
+	int32 RegisterArchetype(const FHitboxArchetypeData& Data);
+	//Called on clients, which use the archetype index the server assigned. The first data registered at an index is kept,
+	//so a later hitbox can't change an archetype every other hitbox already shares. This does nothing on the server, which assigns the indices.
+	void RegisterArchetype(const FHitboxArchetypeData& Data, const int32 ArchetypeIndex);
 	int32 RegisterNewHitbox(UHitbox* Hitbox);
 	void RegisterNewHitbox(UHitbox* Hitbox, const int32 ID);
+	void UnregisterHitbox(UHitbox* Hitbox);
 
 	void ConfirmCollisionOfHitboxes(const int32 InstigatorID, const int32 TargetID, const bool bDamage, const bool bBounce);
+
+	//Queues a contact between two hitboxes to be resolved at the end of the frame. Reporting the same contact from both hitboxes is fine.
+	//Hitboxes that don't have an ID yet, like ones on clients whose ID hasn't replicated, are queued by pointer instead.
+	void QueueHitboxContact(UHitbox* First, UHitbox* Second);
+
+	//While contact results are being sent out, this is the server world time that the current contact happened at. Otherwise it is -1.
+	//Clients send this with their collisions so that the server rewinds to the moment of impact rather than the end of the frame.
+	//Contacts are swept from where both hitboxes ended last frame. The one exception is a hitbox the manager hadn't mirrored yet, such as one whose ID
+	//hasn't replicated; its contacts fall back to the end of the frame.
+	double GetDispatchingContactTime() const { return DispatchingContactTime; }
+
+	//Whether hitbox contacts come from this manager's broadphase instead of physics overlaps. This is fixed for the lifetime of the world.
+	bool IsUsingBroadphase() const { return bUseBroadphase; }
+
+	//Timings of the last frame the manager finished ticking. Registrations are counted towards the frame they happened before.
+	const FHitboxFrameTimings& GetLastFrameTimings() const { return LastFrameTimings; }
+	//Memory held by the manager's slots, state mirror, history, and contact buffers.
+	SIZE_T GetAllocatedSize() const;
 	
+	//Hitbox IDs are generational handles: the low bits index into HitboxSlots and the high bits hold the slot's generation.
+	//The sign bit is never set, so -1 stays free to mean "no hitbox".
+	static constexpr int32 HitboxIndexBits = 20;
+	static constexpr int32 HitboxIndexMask = (1 << HitboxIndexBits) - 1;
+	static constexpr int32 HitboxGenerationMask = (1 << (31 - HitboxIndexBits)) - 1;
+	static int32 MakeHitboxID(const int32 Index, const int32 Generation) { return ((Generation & HitboxGenerationMask) << HitboxIndexBits) | Index; }
+	static int32 GetHitboxIndex(const int32 HitboxID) { return HitboxID & HitboxIndexMask; }
+	static int32 GetHitboxGeneration(const int32 HitboxID) { return (HitboxID >> HitboxIndexBits) & HitboxGenerationMask; }
+
 private:
 
-	int32 HitboxIDCounter = 0;
+	void TickManager(const float DeltaTime);
+	//Copies every hitbox's state into the mirror and works out which slots to record at this history frame, or none if the frame is INDEX_NONE.
+	void RefreshStateMirror(const int64 Frame);
+	//Where the mirror last saw this hitbox, if it was mirrored and hasn't teleported since. Used as the start of its motion over this frame.
+	bool GetMirroredStartLocation(const UHitbox* Hitbox, FVector& OutLocation) const;
+	//Rewinding is const, so the timings it adds to have to be mutable. Everything that adds to these runs on the game thread.
+	mutable FHitboxFrameTimings FrameTimings;
+	FHitboxFrameTimings LastFrameTimings;
+
 	UPROPERTY()
-	TMap<int32, UHitbox*> HitboxMap;
+	TArray<FHitboxSlot> HitboxSlots;
+	//Indices of released slots, reused before growing HitboxSlots. Only used on the server, since clients take their IDs from replication.
+	TArray<int32> FreeSlots;
+	//Returns the slot for this ID, or nullptr if the ID is invalid or refers to a slot that has since been released or reused.
+	const FHitboxSlot* FindSlot(const int32 HitboxID) const;
+	UHitbox* FindHitbox(const int32 HitboxID) const;
+	//Adds a slot at the end of HitboxSlots, keeping the state mirror the same size.
+	int32 AddSlot();
+
+	FHitboxStateMirror StateMirror;
+
+	//Interned hitbox archetypes. There are only ever a handful of these, however many hitboxes there are.
+	TArray<FHitboxArchetypeData> Archetypes;
+	//Capabilities of each archetype, used to index the interaction table.
+	TArray<EHitboxCapabilities> ArchetypeCapabilities;
+	//Clients can learn about archetypes out of order, which leaves gaps in the arrays above until the missing ones arrive.
+	TArray<bool> ArchetypesRegistered;
+	bool IsArchetypeRegistered(const int32 ArchetypeIndex) const { return ArchetypesRegistered.IsValidIndex(ArchetypeIndex) && ArchetypesRegistered[ArchetypeIndex]; }
+	//More archetypes than this are never expected. The server stops assigning indices at this limit, so a larger replicated index is treated as corrupt rather than grown to.
+	static constexpr int32 MaxArchetypes = 1024;
+	//Builds collision params for a hitbox's current state.
+	//Hitboxes that haven't been told their archetype yet, like ones on clients whose archetype hasn't replicated, use their own archetype data.
+	FHitboxCollisionParams GetHitboxCollisionParams(const UHitbox* Hitbox) const;
 	
-	static constexpr int MaxSnapshots = 50;
-	static constexpr float HitboxToleranceMultiplier = 2.0f;
-	UPROPERTY()
-	TMap<int32, FHitboxSnapshotArray> HitboxSnapshots;
-	FVector GetHitboxPositionAtTime(const int32 HitboxID, const float Timestamp) const;
+	//How far back the history reaches. The number of frames this takes depends on the server's frame rate,
+	//so the history starts small and grows until it covers the window, up to MaxHistoryFrames.
+	static constexpr float HistoryWindowMs = 1000.0f;
+	static constexpr int MinHistoryFrames = 32;
+	static constexpr int MaxHistoryFrames = 1024;
+	//Hitboxes that move less than this since they were last recorded aren't recorded again.
+	static constexpr float HistoryMotionEpsilon = 0.01f;
+	//Replayed hitboxes may be this much further apart than their combined radii and still count as touching.
+	//This covers the smoothing applied to simulated proxies on the client, which the server's history doesn't see.
+	static constexpr float HitboxToleranceMultiplier = 1.25f;
+	//Clients can't claim collisions in the future, or further back than we keep history for.
+	static double ClampRewindTime(const double CollisionTime, const double CurrentTime) { return FMath::Clamp(CollisionTime, CurrentTime - HistoryWindowMs / 1000.0, CurrentTime); }
+	FHitboxCollisionParams GetCollisionParams(const int32 Index, const FVector& Location) const;
+	FHitboxCollisionParams MakeCollisionParams(const int32 ArchetypeIndex, const FVector& Location, const FHitboxShape2D& Shape) const;
+	static FHitboxCollisionParams MakeCollisionParams(const FHitboxArchetypeData& Archetype, const EHitboxCapabilities Capabilities, const FVector& Location,
+		const FHitboxShape2D& Shape);
+	FHitboxWorldHistory History;
+	//Which slots moved far enough this frame to be recorded. This is worked out for every slot in parallel, and then the history is written in slot order.
+	TArray<bool> SlotsToRecord;
+	bool ShouldRecordSlot(const int32 Index) const;
+	FHitboxRewindFrame FindRewindFrame(const double Timestamp) const;
+	FVector GetHitboxPositionAtFrame(const int32 Index, const FHitboxRewindFrame& RewindFrame) const;
+	//Reused by every rewind so that gathering doesn't allocate once it has grown to the largest batch.
+	mutable FHitboxLerpBatch RewindBatch;
+	//Rewinds many hitboxes at once, interpolating four at a time with vector math. Indices of INDEX_NONE are skipped and output a zero vector.
+	void RewindHitboxPositions(TConstArrayView<int32> Indices, TConstArrayView<FHitboxRewindFrame> RewindFrames, TArrayView<FVector> OutPositions) const;
+	FVector GetHitboxPositionAtTime(const int32 HitboxID, const double Timestamp) const;
+
+	//Collisions reported by clients this frame. These are all validated together once the frame's history has been recorded.
+	TArray<FHitboxValidationRequest> PendingValidations;
+	void ValidatePendingCollisions(const double CurrentTime);
+	//Replays a single reported collision against the other hitbox's rewound position, clearing any outcomes that don't reproduce.
+	//Only reads the state mirror, so requests can be validated in parallel.
+	void ValidateCollision(FHitboxValidationRequest& Request, const FVector& OtherLocation) const;
+
+	bool bUseBroadphase = true;
+	//Entries for every enabled hitbox, kept sorted by MinX. Hitboxes move a little each frame, so the order from the last frame is nearly sorted already.
+	TArray<FHitboxBroadphaseEntry> BroadphaseEntries;
+	//Pairs of hitbox IDs that were touching last frame, so that only new contacts are reported.
+	TSet<uint64> OverlappingPairs;
+	static uint64 MakePairKey(const int32 A, const int32 B) { return (static_cast<uint64>(FMath::Min(A, B)) << 32) | static_cast<uint32>(FMath::Max(A, B)); }
+	//Pair key of contacts where either hitbox has no ID. IDs never have the sign bit set, so no real pair of IDs makes this key, and these contacts sort last.
+	static constexpr uint64 UnregisteredPairKey = MAX_uint64;
+	//Hitboxes that move further than this in one frame are treated as teleporting, and aren't swept along the way.
+	static constexpr float MaxSweepDistance = 2000.0f;
+	//Finds hitboxes that started touching this frame and queues the contacts, the same way a physics overlap would.
+	void UpdateBroadphase();
+
+	//Contacts that started this frame, possibly with duplicates.
+	TArray<FHitboxPendingContact> PendingContacts;
+	//Length of the frame the contacts happened in, for converting times of impact to world times.
+	float ContactFrameDeltaTime = 0.0f;
+	double DispatchingContactTime = -1.0;
+	TArray<FHitboxContact> Contacts;
+	//Worker threads push results here as they resolve contacts, and the game thread drains it once they are all done.
+	TQueue<FHitboxContactResult, EQueueMode::Mpsc> ContactResultQueue;
+	TArray<FHitboxContactResult> ContactResults;
+	//Resolves each unique contact once across worker threads, then sends out all of the results in order of hitbox IDs.
+	void ResolvePendingContacts();
+	//Whether an earlier contact in the sorted list, among those without IDs, is between the same two hitboxes.
+	bool IsDuplicateUnregisteredContact(const int32 Contact) const;
 	
-};
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "CombatInterface.h"
+#include "GameFramework/Actor.h"
+#include "HitboxStressActor.generated.h"
+
+class UHitbox;
+
+//A bare hitbox that moves back and forth along a fixed path, spawned by the hitbox stress test.
+UCLASS(NotPlaceable)
+class MARIOCLONE_API AHitboxStressActor : public AActor, public ICombatInterface
+{
+	GENERATED_BODY()
+
+public:
+
+	AHitboxStressActor();
+	virtual void Tick(float DeltaTime) override;
+
+	//Has to be called before the actor finishes spawning, since hitboxes pick their collision setup from their owner's hostility when they initialize.
+	void InitStressMotion(const EHostility InHostility, const FVector& InCenter, const FVector& InAmplitude, const float InPeriod, const float InPhase);
+	UHitbox* GetHitbox() const { return Hitbox; }
+
+	virtual EHostility GetHostility_Implementation() const override { return Hostility; }
+	virtual UHealthComponent* GetHealthComponent_Implementation() const override { return nullptr; }
+	virtual void InstantKill_Implementation() override {}
+
+private:
+
+	UPROPERTY(VisibleAnywhere)
+	UHitbox* Hitbox;
+
+	EHostility Hostility = EHostility::Enemy;
+	FVector Center = FVector::ZeroVector;
+	FVector Amplitude = FVector::ZeroVector;
+	float Period = 1.0f;
+	float Phase = 0.0f;
+	float Elapsed = 0.0f;
+};
\ No newline at end of file
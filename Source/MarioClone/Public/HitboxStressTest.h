@@ -0,0 +1,54 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HitboxStressTest.generated.h"
+
+class AHitboxStressActor;
+
+//Spawns a crowd of moving hitboxes and records the hitbox manager's timings every frame, so that its cost can be tracked as hitbox counts grow.
+//Started on the server with the Hitboxes.StressTest console command, which also works on a headless server running with -nullrhi.
+//Results are written to a CSV in the profiling directory when the run finishes. Running with -llm adds the bytes each manager path has allocated.
+UCLASS()
+class MARIOCLONE_API UHitboxStressTest : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override { return true; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Always; }
+	virtual TStatId GetStatId() const override;
+	virtual void Tick(float DeltaTime) override;
+
+	//In a storm, every hitbox is packed into one small area, so that they are all running into each other at once.
+	void StartStressTest(const int32 NumHitboxes, const int32 NumFrames, const bool bInStorm);
+	bool IsRunning() const { return bRunning; }
+	//Where the last finished run's results were written, or empty if they couldn't be.
+	const FString& GetResultsPath() const { return ResultsPath; }
+
+private:
+
+	bool bRunning = false;
+	bool bStorm = false;
+	int32 FramesRemaining = 0;
+	int32 FrameNumber = 0;
+	UPROPERTY()
+	TArray<AHitboxStressActor*> StressActors;
+	//Seeded the same way every run, so that runs with the same arguments are comparable.
+	FRandomStream Stream;
+	uint64 StartUsedPhysical = 0;
+	//One line per frame, written out when the run finishes.
+	TArray<FString> CsvLines;
+	FString ResultsPath;
+
+	//Far above the level, so that the stress hitboxes don't run into anything else.
+	static constexpr float StressOriginZ = 50000.0f;
+	static constexpr float GridSpacing = 150.0f;
+	static constexpr float StormRadius = 300.0f;
+	//Collisions reported against hitboxes this far back, like clients with high latency would.
+	static constexpr float MaxValidationLatency = 0.2f;
+
+	//Reports collisions between random neighboring hitboxes, so that every frame also pays for rewinding and validation.
+	void QueueValidations();
+	void FinishStressTest();
+};
\ No newline at end of file
@@ -14,6 +14,7 @@ public:
 	
 	AKillbox();
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 
@@ -25,4 +26,9 @@ private:
 	UFUNCTION()
 	void OnCollision(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 		UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	//Used instead of the collision box's overlap events when the trigger region grid is enabled.
+	int32 TriggerRegionID = INDEX_NONE;
+	void OnRegionEntered(APawn* Pawn);
+	void KillActor(AActor* Actor);
 };
\ No newline at end of file
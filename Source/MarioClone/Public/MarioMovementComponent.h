@@ -1,9 +1,38 @@
 ﻿#pragma once
 #include "CoreMinimal.h"
+#include "HitboxCollision.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "MarioMovementComponent.generated.h"
 
 class UHitboxManager;
+class UTileCollisionManager;
+
+//A hitbox collision the locally controlled client processed, sent to the server with the move it happened before.
+struct FMarioCollisionEvent
+{
+	//Counts up for each event a client sends, so that the server can drop events it has already seen in resent moves.
+	uint16 Sequence = 0;
+	int32 ThisHitboxID = -1;
+	int32 OtherHitboxID = -1;
+	FHitboxCollisionOutcome Outcome;
+	//Server world time, as estimated by the client, at which the collision happened. The server rewinds the other hitbox to this time to validate it.
+	double CollisionTime = -1.0;
+};
+
+//The collisions that happened before one move. This is fixed size so that saved moves can be copied and pooled without allocating.
+//Events in one queue always have consecutive sequence numbers, which lets the move data only send the first one.
+struct FMarioCollisionEvents
+{
+	//More collisions than this in a single frame are dropped. Hitting this many hitboxes at once doesn't happen in practice.
+	static constexpr int32 Capacity = 4;
+	FMarioCollisionEvent Events[Capacity];
+	int32 Num = 0;
+
+	bool IsEmpty() const { return Num == 0; }
+	bool IsFull() const { return Num == Capacity; }
+	void Add(const FMarioCollisionEvent& Event) { Events[Num++] = Event; }
+	void Reset() { Num = 0; }
+};
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class MARIOCLONE_API UMarioMovementComponent : public UCharacterMovementComponent
@@ -25,12 +54,7 @@ class MARIOCLONE_API UMarioMovementComponent : public UCharacterMovementComponen
 		virtual uint8 GetCompressedFlags() const override;
 
 		uint8 bSavedWantsBounce : 1;
-		int32 SavedThisBounceBoxID = -1;
-		int32 SavedOtherBounceBoxID = -1;
-		bool bSavedBouncedThis = false;
-		bool bSavedBouncedOther = false;
-		bool bSavedDamagedThis = false;
-		bool bSavedDamagedOther = false;
+		FMarioCollisionEvents SavedCollisionEvents;
 	};
 
 	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
@@ -44,8 +68,19 @@ class MARIOCLONE_API UMarioMovementComponent : public UCharacterMovementComponen
 
 		typedef FNetworkPredictionData_Client_Character Super;
 
+		//Saved moves allocated by the first move an autonomous proxy saves, enough to cover the moves waiting for acknowledgement at a high ping.
+		//Freed moves go back to the pool in FreeMoves, so after this no more are allocated unless the connection gets worse.
+		static constexpr int32 PreallocatedMoveCount = 32;
+		//Every saved move allocated so far, including the preallocated ones.
+		int32 NumAllocatedMoves = 0;
+
 		FNetworkPredictionData_Client_Mario(const UCharacterMovementComponent& ClientMovement);
 		virtual FSavedMovePtr AllocateNewMove() override;
+		virtual FSavedMovePtr CreateSavedMove(ACharacter* C, const float DeltaTime, const FVector& NewAccel) override;
+
+	private:
+
+		bool bPreallocatedMoves = false;
 	};
 
 	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
@@ -59,15 +94,17 @@ class MARIOCLONE_API UMarioMovementComponent : public UCharacterMovementComponen
 
 		typedef FCharacterNetworkMoveData Super;
 
-		int32 ThisBounceBoxID = -1;
-		int32 OtherBounceBoxID = -1;
-		bool bBouncedThis = false;
-		bool bBouncedOther = false;
-		bool bDamagedThis = false;
-		bool bDamagedOther = false;
+		FMarioCollisionEvents CollisionEvents;
 
 		virtual void ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType) override;
 		virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType) override;
+
+	private:
+
+		//Writes a hitbox ID as a packed slot index and generation, which are both small for any real number of hitboxes.
+		static void SerializeHitboxID(FArchive& Ar, int32& HitboxID);
+		//What the single collision the move data could carry before it was bit-packed would have cost, so the saving can be compared in stats.
+		int32 GetUnpackedBits() const;
 	};
 
 	struct FMarioNetworkMoveDataContainer : public FCharacterNetworkMoveDataContainer
@@ -103,6 +140,18 @@ public:
 	void OnHitboxCollision(const int32 ThisID, const int32 OtherID,
 		const bool bThisBounced, const bool bOtherBounced, const bool bThisDamaged, const bool bOtherDamaged);
 
+	//Floor finding goes to the baked tile collision instead of the physics scene when it's enabled for the world.
+	//Movement sweeps go to the tiles first, and then to the physics scene only as far as the tiles allow, for just the pawn, dynamic and physics body object types.
+	virtual void ComputeFloorDist(const FVector& CapsuleLocation, float LineDistance, float SweepDistance, FFindFloorResult& OutFloorResult, float SweepRadius, const FHitResult* DownwardSweepResult = NULL) const override;
+	bool IsUsingTileCollision() const;
+	//Saved moves allocated for this character's client prediction so far. This stops growing once the pool covers the moves waiting for acknowledgement.
+	int32 GetNumAllocatedSavedMoves() const;
+
+protected:
+
+	virtual void PerformMovement(float DeltaTime) override;
+	virtual bool MoveUpdatedComponentImpl(const FVector& Delta, const FQuat& NewRotation, bool bSweep, FHitResult* OutHit = nullptr, ETeleportType Teleport = ETeleportType::None) override;
+
 private:
 
 	//Multiplier on gravity when velocity is downward, to make jumping and falling faster.
@@ -111,11 +160,26 @@ private:
 
 	UPROPERTY()
 	UHitboxManager* HitboxManager = nullptr;
+	UPROPERTY()
+	UTileCollisionManager* TileCollisionManager = nullptr;
+	//Collisions are predicted by the owning client, which sends them to the server with its moves.
+	bool PredictsCollisions() const;
+	//Tile collision treats the capsule as a box in the X/Z plane.
+	FVector2D GetTileCollisionExtent() const;
+	//Sweeps the capsule against the object types that aren't baked into the tiles and finds the first one that blocks it.
+	bool SweepUnbakedObjects(const FVector& Start, const FVector& Delta, FHitResult& OutHit) const;
+	//Queues a collision to send with the next move. Collisions past the queue's capacity are dropped.
+	void AddCollisionEvent(const int32 ThisID, const int32 OtherID, const FHitboxCollisionOutcome& Outcome);
 	uint8 bWantsBounce : 1;
-	int32 ThisHitboxID = -1;
-	int32 OtherHitboxID = -1;
-	bool bBouncedThis = false;
-	bool bBouncedOther = false;
-	bool bDamagedThis = false;
-	bool bDamagedOther = false;
+	//Collisions since the last move, applied at the start of the next one.
+	FMarioCollisionEvents CollisionEvents;
+	//Sequence number for the next collision the local client processes.
+	uint16 NextCollisionSequence = 0;
+	//The newest collision the server has applied for this client, so that events in resent moves are only applied once.
+	uint16 LastAppliedCollisionSequence = 0;
+	bool bHasAppliedCollision = false;
+
+#if WITH_DEV_AUTOMATION_TESTS
+	friend struct FMarioMovementTestAccess;
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,19 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "MarioMovementSettings.generated.h"
+
+//Project settings for Mario movement, under Game > Mario Movement.
+//These come from the project's config, which every client and the server load, so unlike a console variable they can't differ between them.
+UCLASS(Config = Game, DefaultConfig, meta = (DisplayName = "Mario Movement"))
+class MARIOCLONE_API UMarioMovementSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+
+	//Resolve Mario movement against a baked 2D copy of the level's static geometry instead of physics scene queries.
+	//Read by each world when it is created, so changes take effect for worlds created afterwards.
+	UPROPERTY(Config, EditAnywhere, Category = "Tile Collision")
+	bool bUseTileCollision = false;
+};
\ No newline at end of file
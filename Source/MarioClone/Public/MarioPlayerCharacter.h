@@ -114,16 +114,19 @@ private:
 #pragma endregion 
 #pragma region Movement
 
-private:
-
-	UPROPERTY()
-	UMarioMovementComponent* MarioMoveComponent;
+public:
 
+	//Bound to player input, and also called by the movement simulation test to feed it scripted input.
 	UFUNCTION()
 	void MovementInput(const float AxisValue);
 	UFUNCTION()
 	void JumpPressed();
 
+private:
+
+	UPROPERTY()
+	UMarioMovementComponent* MarioMoveComponent;
+
 #pragma endregion
 #pragma region Health
 
@@ -17,7 +17,7 @@ struct FRespawnInfo
 	UPROPERTY()
 	bool bRespawning = false;
 	UPROPERTY()
-	float RespawnTime = -1.0f;
+	double RespawnTime = -1.0;
 	UPROPERTY()
 	FVector RespawnLocation = FVector::ZeroVector;
 };
@@ -69,7 +69,7 @@ public:
 	virtual void InstantKill_Implementation() override;
 
 	//When respawning, returns the timestamp at which the respawn will occur.
-	float GetRespawnTime() const { return RespawnInfo.bRespawning ? RespawnInfo.RespawnTime : -1.0f; }
+	double GetRespawnTime() const { return RespawnInfo.bRespawning ? RespawnInfo.RespawnTime : -1.0; }
 
 private:
 
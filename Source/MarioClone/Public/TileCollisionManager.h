@@ -0,0 +1,57 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TileCollisionManager.generated.h"
+
+DECLARE_STATS_GROUP(TEXT("TileCollision"), STATGROUP_TileCollision, STATCAT_Advanced);
+
+//A piece of static level geometry, flattened to its bounds in the X/Z plane.
+struct FTileCollisionBox
+{
+	FBox2D Bounds = FBox2D(ForceInit);
+	//The geometry only blocks pawns whose Y is inside this range, so background scenery doesn't collide.
+	float MinY = 0.0f;
+	float MaxY = 0.0f;
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+};
+
+//Collision for movement against a baked 2D copy of the level, since play is locked to the X/Z plane.
+//Every static primitive that blocks pawns is baked as its bounds when the world begins play, and bucketed into a grid of tiles.
+//This is exact for the block geometry levels are built from, but slopes and rotated geometry become their bounding boxes.
+//Movable geometry and other pawns aren't baked, so movement still sweeps the physics scene for them, only as far as the tiles allow.
+UCLASS()
+class MARIOCLONE_API UTileCollisionManager : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override { return true; }
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	//Whether movement components should query the tiles instead of the physics scene. This comes from the project settings and is fixed for the lifetime of the world,
+	//so that clients and the server agree.
+	bool IsUsingTileCollision() const { return bUseTileCollision; }
+	//Sweep a box with the given half extents in the X/Z plane. Returns true and fills in the hit if anything blocks it.
+	//Boxes that already overlap the start only block movement further into them, so a pawn that ends up slightly inside geometry can always move out.
+	//Those hits start penetrating, with the normal and depth of the shallowest way out.
+	bool SweepBox(const FVector& Start, const FVector& Delta, const FVector2D& HalfExtents, FHitResult& OutHit) const;
+
+	int32 GetNumBoxes() const { return Boxes.Num(); }
+
+private:
+
+	bool bUseTileCollision = false;
+
+	TArray<FTileCollisionBox> Boxes;
+	void BakeLevel(UWorld& InWorld);
+
+	static constexpr float TileSize = 500.0f;
+	TMap<FIntPoint, TArray<int32>> Tiles;
+	static FIntPoint GetTile(const FVector2D& Point) { return FIntPoint(FMath::FloorToInt32(Point.X / TileSize), FMath::FloorToInt32(Point.Y / TileSize)); }
+
+	//Boxes span several tiles, so each query stamps the boxes it has tested to skip them in later tiles.
+	mutable TArray<uint32> BoxQueryStamps;
+	mutable uint32 QueryStamp = 0;
+};
@@ -0,0 +1,77 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TriggerRegionManager.generated.h"
+
+DECLARE_STATS_GROUP(TEXT("Triggers"), STATGROUP_Triggers, STATCAT_Advanced);
+
+DECLARE_DELEGATE_OneParam(FTriggerRegionCallback, APawn*);
+
+//A static region of the level that does something when a pawn enters it, like a killbox, level goal, or collectible.
+struct FTriggerRegion
+{
+	//Bounds in the X/Z plane. For sphere regions, this is the square around the circle.
+	FBox2D Bounds = FBox2D(ForceInit);
+	bool bIsCircle = false;
+	FVector2D Center = FVector2D::ZeroVector;
+	float Radius = 0.0f;
+	bool bEnabled = true;
+	//Set once the region unregisters. The region's index is never reused, since the regions in a level are fixed.
+	bool bRegistered = true;
+	FTriggerRegionCallback Callback;
+};
+
+//Tests pawns against every trigger region in the level once per frame, instead of giving each region its own physics body.
+//Regions are bucketed into a 2D grid over the X/Z plane the first time the manager ticks after a region registers.
+UCLASS()
+class MARIOCLONE_API UTriggerRegionManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override { return true; }
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Always; }
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UTriggerRegionManager, STATGROUP_Triggers); }
+	virtual void Tick(float DeltaTime) override;
+
+	//Whether trigger actors should register regions here instead of using physics overlaps. This is fixed for the lifetime of the world.
+	bool IsUsingRegionGrid() const { return bUseRegionGrid; }
+	//Register a region and get back its ID. The callback is only ever called on the server, when a pawn enters the region.
+	int32 RegisterBoxRegion(const FBox& Box, const FTriggerRegionCallback& Callback);
+	int32 RegisterSphereRegion(const FVector& Center, const float Radius, const FTriggerRegionCallback& Callback);
+	void UnregisterRegion(const int32 RegionID);
+	//Disabled regions don't trigger. Pawns already inside a region when it is enabled will trigger it, just like enabling collision would.
+	void SetRegionEnabled(const int32 RegionID, const bool bEnabled);
+
+private:
+
+	bool bUseRegionGrid = true;
+
+	TArray<FTriggerRegion> Regions;
+	int32 AddRegion(FTriggerRegion&& Region);
+
+	static constexpr float GridCellSize = 1000.0f;
+	//Regions covering more cells than this, like a killbox under the whole level, are tested against every pawn instead.
+	static constexpr int32 MaxCellsPerRegion = 64;
+	TMap<FIntPoint, TArray<int32>> GridCells;
+	TArray<int32> LargeRegions;
+	bool bGridDirty = false;
+	void RebuildGrid();
+	static FIntPoint GetCell(const FVector2D& Point) { return FIntPoint(FMath::FloorToInt32(Point.X / GridCellSize), FMath::FloorToInt32(Point.Y / GridCellSize)); }
+
+	//Regions can span several cells, so each pawn's query stamps the regions it has gathered to skip them in later cells.
+	TArray<uint32> RegionQueryStamps;
+	uint32 QueryStamp = 0;
+	//Regions to test against the current pawn. Kept between ticks so that it only allocates while it grows.
+	TArray<int32> Candidates;
+
+	//Region and pawn pairs that were overlapping last frame, so that regions only trigger when a pawn enters.
+	//This frame's overlaps are gathered into the other set, and the two are swapped at the end of the tick, so neither is reallocated every frame.
+	TSet<TPair<int32, TWeakObjectPtr<APawn>>> OverlappingPawns;
+	TSet<TPair<int32, TWeakObjectPtr<APawn>>> CurrentOverlaps;
+	TArray<TPair<int32, TWeakObjectPtr<APawn>>> Entered;
+	static bool OverlapsRegion(const FTriggerRegion& Region, const FBox2D& PawnBounds);
+};
\ No newline at end of file
@@ -27,6 +27,6 @@ private:
 
 	UPROPERTY()
 	ANPCCharacter* CharacterRef;
-	float RespawnStartTime = 0.0f;
-	float RespawnEndTime = 0.0f;
+	double RespawnStartTime = 0.0;
+	double RespawnEndTime = 0.0;
 };